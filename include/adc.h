@@ -6,12 +6,96 @@
 /// @details      The first function to be called in order to use the adc is
 ///               adc_init. After that a channel shall be selected by adc_selectChannel
 ///               before conversions may be trigged by adc_start8 or adc_start10.
+///               Alternatively, a list of channels can be converted one after another by the scan
+///               sequencer: the channels are added by @ref adc_scanAdd and the scans get started
+///               by @ref adc_scanStart. The ADC interrupt stores every result in the ring buffer of
+///               its channel and selects the next channel of the list, so that a scan costs one
+///               short interrupt per conversion and the callback is called once per scan.
+///               Every channel of a scan can be filtered by the interrupt (see
+///               @ref adc_scanSetFilter): 4^n conversions in a row are summed up and decimated to
+///               a result with n extra bits, and a median over the last 3 or 5 results removes
+///               single outliers. Channels that change slowly can be converted in every n-th scan
+///               only (see @ref adc_scanSetDivider).
+///               Several modules can share the ADC: single conversions (@ref adc_request and
+///               @ref adc_trigger8 / @ref adc_trigger10) are put into a queue, which the ADC
+///               interrupt serves back to back. Queued requests wait for the end of a running
+///               scan and delay the next one; the latency from the request to the result is
+///               recorded per client (see @ref adc_getClientStats). Only the auto trigger mode
+///               (@ref adc_autoTrigger8, @ref adc_autoTrigger10) and the capture need the ADC
+///               exclusively; while the auto trigger mode is active, requests, scans and captures
+///               fail instead of ending it silently.
+///               @ref adc_convertSleeping converts a channel in the ADC noise reduction mode, in
+///               which the CPU and the I/O clock are stopped, unless an interrupt of the timebase
+///               is due within the conversion.
+///               The monitor (see @ref adc_monitorStart) measures the internal 1.1V bandgap against
+///               AVCC and a battery divider periodically, so that other modules can correct their
+///               conversions ratiometrically (@ref adc_getVcc_mV) or adapt to the battery voltage
+///               (@ref adc_getBattery_mV) without conversions of their own.
+///               The capture (see @ref adc_captureStart) converts a channel free-running with a
+///               selectable prescaler and stores the upper 8 bits of the results into two buffers
+///               in turn, e.g. to record waveforms with up to 77k samples per second.
+///               The build flags ADC_SCAN_CHANNELS (8 by default) and ADC_SCAN_BUFFER_SIZE (a power
+///               of 2; 4 values per channel by default), ADC_QUEUE_SIZE (a power of 2; 8 requests
+///               by default) and ADC_CLIENTS (4 by default) set the memory used.
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
 #ifndef ADC_H_
 #define ADC_H_
 
+#include <avr/io.h>
+
+/// @cond HIDDEN_SYMBOLS
+#ifndef ADC_SCAN_CHANNELS
+#define ADC_SCAN_CHANNELS 8
+#endif
+#ifndef ADC_SCAN_BUFFER_SIZE
+#define ADC_SCAN_BUFFER_SIZE 4
+#endif
+#ifndef ADC_QUEUE_SIZE
+#define ADC_QUEUE_SIZE 8
+#endif
+#ifndef ADC_CLIENTS
+#define ADC_CLIENTS 4
+#endif
+#ifndef ADC_SLEEP_MARGIN_US
+#define ADC_SLEEP_MARGIN_US 48
+#endif
+#ifndef ADC_BANDGAP_MV
+#define ADC_BANDGAP_MV 1100
+#endif
+#ifndef ADC_BATTERY_ALARMS
+#define ADC_BATTERY_ALARMS 2
+#endif
+#ifndef ADC_BATTERY_HYSTERESIS_MV
+#define ADC_BATTERY_HYSTERESIS_MV 100
+#endif
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief			  returned by @ref adc_scanAdd and @ref adc_registerClient on failure
+#define ADC_INVALID 0xFF
+
+// ----------------------------------------------------------------------------
+/// @brief			  the channel of the internal 1.1V bandgap reference (ADC_BANDGAP_MV, which can be
+///               calibrated per device)
+#define ADC_CH_BANDGAP 30
+
+// ----------------------------------------------------------------------------
+/// @brief			  the client of @ref adc_trigger8 and @ref adc_trigger10
+#define ADC_CLIENT_DEFAULT 0
+
+// ----------------------------------------------------------------------------
+/// @brief			  the latencies of the requests of a client (see @ref adc_getClientStats)
+struct AdcClientStats
+{
+    uint16_t requests; ///< the number of completed requests (stops at 65535)
+    uint16_t dropped;  ///< the number of requests rejected (full queue or auto trigger mode)
+    uint16_t min_us;   ///< the shortest time from a request to its result in microseconds
+    uint16_t mean_us;  ///< the mean time from a request to its result in microseconds
+    uint16_t max_us;   ///< the longest time from a request to its result in microseconds
+};
+
 // ----------------------------------------------------------------------------
 /// @brief        used to set the ADC's reference voltage for the conversion.
 // ----------------------------------------------------------------------------
@@ -34,8 +118,34 @@ typedef enum
     ADC_TS_TIMER0_OVF = 4,   ///< trigger the ADC when timer0 overruns
     ADC_TS_TIMER1_COMPB = 5, ///< trigger the ADC on a timer1 compare match B
     ADC_TS_TIMER1_OVF = 6,   ///< trigger the ADC when timer1 overruns
+    ADC_TS_SOFTWARE = 8,     ///< scans only: every scan is started by @ref adc_scanTrigger
 } ADC_TriggerSource;
 
+// ----------------------------------------------------------------------------
+/// @brief        used to set the clock divider of the capture; the sample rate is
+///               F_CPU / divider / 13, i.e. 9.6k samples per second with ADC_PS_128 and 77k
+///               samples per second with ADC_PS_16 at 16MHz.
+// ----------------------------------------------------------------------------
+typedef enum
+{
+    ADC_PS_2 = 1,   ///< the clock divider is 2 (too fast for the interrupt)
+    ADC_PS_4 = 2,   ///< the clock divider is 4 (too fast for the interrupt)
+    ADC_PS_8 = 3,   ///< the clock divider is 8 (too fast for the interrupt)
+    ADC_PS_16 = 4,  ///< the clock divider is 16; the fastest rate the interrupt can keep up with
+    ADC_PS_32 = 5,  ///< the clock divider is 32
+    ADC_PS_64 = 6,  ///< the clock divider is 64
+    ADC_PS_128 = 7  ///< the clock divider is 128; full accuracy (used by all other conversions)
+} ADC_Prescaler;
+
+// ----------------------------------------------------------------------------
+/// @brief        used to set the resolution of a channel of the scan sequencer.
+// ----------------------------------------------------------------------------
+typedef enum
+{
+    ADC_RES_8 = 0, ///< the result is the upper 8 bits of the conversion
+    ADC_RES_10 = 1 ///< the result is the full 10-bit conversion
+} ADC_Resolution;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -47,9 +157,14 @@ extern "C"
     void adc_init();
 
     // ----------------------------------------------------------------------------
-    /// @brief        Selects the ADC input whose voltage shall be converted.
+    /// @brief        Selects the ADC input whose voltage shall be converted by @ref adc_trigger8,
+    ///               @ref adc_trigger10 and the auto trigger mode.
+    /// @details      A conversion, which a callback of adc_trigger8 or adc_trigger10 triggers
+    ///               again, uses the channel selected at that time, so that the callback can
+    ///               switch between channels. Requests already queued keep their channel; the
+    ///               auto trigger mode keeps its channel until it is restarted.
     /// @param[in]    refVoltage  the reference voltage
-    /// @param[in]    channelNo   the number of the channel to convert (0 - 15).
+    /// @param[in]    channelNo   the number of the channel to convert (0 - 15 or ADC_CH_BANDGAP).
     // ----------------------------------------------------------------------------
     void adc_selectChannel(ADC_RefVoltage refVoltage, uint8_t channelNo);
 
@@ -58,7 +173,8 @@ extern "C"
     /// @details      When the conversion is finished, the given callback function
     ///               is called. If the callback function returns 0, no conversion
     ///               will follow, otherwise a new conversion gets automatically
-    ///               triggered.
+    ///               triggered. The conversion is a request of ADC_CLIENT_DEFAULT
+    ///               (see @ref adc_request).
     /// @param[in]    callback    the callback function.
     // ----------------------------------------------------------------------------
     void adc_trigger8(uint8_t (*callback)(uint8_t value));
@@ -68,7 +184,8 @@ extern "C"
     /// @details      When the conversion is finished, the given callback function
     ///               is called. If the callback function returns 0, no conversion
     ///               will follow, otherwise a new conversion gets automatically
-    ///               triggered.
+    ///               triggered. The conversion is a request of ADC_CLIENT_DEFAULT
+    ///               (see @ref adc_request).
     /// @param[in]    callback    the callback function.
     // ----------------------------------------------------------------------------
     void adc_trigger10(uint8_t (*callback)(uint16_t value));
@@ -78,7 +195,10 @@ extern "C"
     ///               by the selected source.
     /// @details      When the conversion is finished, the given callback function
     ///               is called and the conversion gets automatically retriggered by
-    ///               the selected source.
+    ///               the selected source. The auto trigger mode needs the ADC
+    ///               exclusively; it fails, while a scan is running or requests are
+    ///               queued. Requests, scans and captures fail, until it is ended by
+    ///               @ref adc_autoStop.
     /// @param[in]    callback    the callback function.
     // ----------------------------------------------------------------------------
     void adc_autoTrigger8(ADC_TriggerSource triggerSource, void (*callback)(uint8_t value));
@@ -88,11 +208,269 @@ extern "C"
     ///               by the selected source.
     /// @details      When the conversion is finished, the given callback function
     ///               is called and the conversion gets automatically retriggered by
-    ///               the selected source.
+    ///               the selected source. The auto trigger mode needs the ADC
+    ///               exclusively; it fails, while a scan is running or requests are
+    ///               queued. Requests, scans and captures fail, until it is ended by
+    ///               @ref adc_autoStop.
     /// @param[in]    callback    the callback function.
     // ----------------------------------------------------------------------------
     void adc_autoTrigger10(ADC_TriggerSource triggerSource, void (*callback)(uint16_t value));
 
+    // ----------------------------------------------------------------------------
+    /// @brief        Ends the auto trigger mode and turns off the ADC.
+    // ----------------------------------------------------------------------------
+    void adc_autoStop();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Starts to capture a channel.
+    /// @details      The channel is converted free-running with 8 bits (ADLAR, ADCH only), whose
+    ///               accuracy suffers less from the faster ADC clock than the lower bits. The
+    ///               interrupt only stores each sample into the current buffer. Once it is full,
+    ///               the buffer is handed out (see @ref adc_captureGet), the callback is called and
+    ///               the other buffer gets filled. The handed-out buffer has to be released by
+    ///               @ref adc_captureRelease before the other buffer is full; otherwise the samples
+    ///               of the other buffer get lost (see @ref adc_captureGetOverruns).
+    ///               The capture needs the ADC exclusively: it fails, while a scan is running,
+    ///               requests are queued or the auto trigger mode is active, and later requests
+    ///               and scans wait for @ref adc_captureStop.
+    /// @param[in]    refVoltage  the reference voltage
+    /// @param[in]    channelNo   the number of the channel to capture (0 - 15 or ADC_CH_BANDGAP)
+    /// @param[in]    prescaler   the clock divider, which sets the sample rate
+    /// @param[in]    pBuffers    the memory of both buffers (2 * length bytes)
+    /// @param[in]    length      the number of samples per buffer
+    /// @param[in]    callback    the function, which is called by the ADC interrupt with each full
+    ///                           buffer; may be NULL
+    /// @retval       1           the capture has been started
+    /// @retval       0           the ADC is in use or an argument is invalid
+    // ----------------------------------------------------------------------------
+    uint8_t adc_captureStart(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Prescaler prescaler, uint8_t *pBuffers,
+                             uint16_t length, void (*callback)(const uint8_t *pBuffer, uint16_t length));
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the full buffer of the capture, which has been handed out.
+    /// @return       the buffer; NULL, if no buffer is full or the buffer has been released
+    // ----------------------------------------------------------------------------
+    const uint8_t *adc_captureGet();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Releases the full buffer of the capture, so that it can be filled again.
+    // ----------------------------------------------------------------------------
+    void adc_captureRelease();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns how often a full buffer of the capture had to be dropped, since the
+    ///               other buffer had not been released.
+    /// @return       the number of dropped buffers
+    // ----------------------------------------------------------------------------
+    uint16_t adc_captureGetOverruns();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Stops the capture. The buffer being filled is discarded.
+    // ----------------------------------------------------------------------------
+    void adc_captureStop();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Registers a client of the request queue, whose latencies are recorded
+    ///               separately.
+    /// @return       the client or ADC_INVALID, if ADC_CLIENTS clients are registered
+    // ----------------------------------------------------------------------------
+    uint8_t adc_registerClient();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Puts a single conversion into the request queue. Can be called by interrupts.
+    /// @details      The conversion starts at once, if the ADC is free; otherwise after the
+    ///               requests queued before and after a running scan. The callback is called by
+    ///               the ADC interrupt; if it returns 1, the request is queued again.
+    /// @param[in]    client      ADC_CLIENT_DEFAULT or a client of @ref adc_registerClient
+    /// @param[in]    refVoltage  the reference voltage
+    /// @param[in]    channelNo   the number of the channel to convert (0 - 15 or ADC_CH_BANDGAP)
+    /// @param[in]    resolution  the resolution of the result
+    /// @param[in]    callback    the function, which gets the result
+    /// @retval       1           the request has been queued
+    /// @retval       0           the queue is full or the auto trigger mode is active; counted as
+    ///                           dropped (see @ref adc_getClientStats)
+    // ----------------------------------------------------------------------------
+    uint8_t adc_request(uint8_t client, ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution,
+                        uint8_t (*callback)(uint16_t value));
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the latencies of the requests of a client. The latencies are measured
+    ///               with the timebase and are 0 without it.
+    /// @param[in]    client      the client
+    /// @param[out]   pStats      the statistics
+    /// @retval       1           ok
+    /// @retval       0           invalid client
+    // ----------------------------------------------------------------------------
+    uint8_t adc_getClientStats(uint8_t client, struct AdcClientStats *pStats);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Starts the supply and battery monitor.
+    /// @details      A low-priority function of the timebase requests a conversion of the bandgap
+    ///               and of the battery divider against AVCC every period_ms. AVCC follows from
+    ///               the bandgap and the battery voltage from AVCC and the divider; both are
+    ///               low-pass filtered. The timebase has to be initialized.
+    /// @param[in]    batteryChannel  the channel of the battery divider (0 - 15); ADC_INVALID to
+    ///                               measure AVCC only
+    /// @param[in]    ratio_permille  the battery voltage divided by the voltage at the channel in
+    ///                               permille, e.g. 3128 for a divider of 10k and 4.7k
+    /// @param[in]    period_ms       the measurement interval
+    // ----------------------------------------------------------------------------
+    void adc_monitorStart(uint8_t batteryChannel, uint16_t ratio_permille, uint16_t period_ms);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Stops the supply and battery monitor. The last values are kept.
+    // ----------------------------------------------------------------------------
+    void adc_monitorStop();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Adds a function, which is called once the battery voltage falls below a
+    ///               threshold. It is called again after the voltage has risen above the threshold
+    ///               plus ADC_BATTERY_HYSTERESIS_MV (100mV by default) and fallen once more.
+    ///               The functions are called by the low-priority function of the monitor.
+    /// @param[in]    threshold_mV    the threshold in millivolts
+    /// @param[in]    callback        the function, which gets the battery voltage
+    /// @retval       1               the function has been added
+    /// @retval       0               ADC_BATTERY_ALARMS (2 by default) functions have been added
+    // ----------------------------------------------------------------------------
+    uint8_t adc_addLowBatteryCallback(uint16_t threshold_mV, void (*callback)(uint16_t battery_mV));
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the supply voltage AVCC measured by the monitor.
+    /// @return       the voltage in millivolts; 0 before the first measurement
+    // ----------------------------------------------------------------------------
+    uint16_t adc_getVcc_mV();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the battery voltage measured by the monitor.
+    /// @return       the voltage in millivolts; 0 before the first measurement
+    // ----------------------------------------------------------------------------
+    uint16_t adc_getBattery_mV();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Converts a channel, while the CPU sleeps in SLEEP_MODE_ADC, and waits for
+    ///               the result. Must not be called by interrupts.
+    /// @details      The function waits, until running requests and scans have finished; it fails
+    ///               in the auto trigger mode and during a capture. The
+    ///               sleep mode stops the I/O clock and thereby the timers (including the PWM of
+    ///               the motors and the timebase, which lags behind by the conversion time of
+    ///               104us to 200us) and the UARTs, so that their switching noise does not
+    ///               disturb the conversion. The CPU is only sent to sleep, if the next interrupt
+    ///               of the timebase is more than the conversion time plus ADC_SLEEP_MARGIN_US
+    ///               (48us by default) away; otherwise, the channel is converted with the CPU
+    ///               awake. The same applies, while UART0 is still sending (see
+    ///               @ref uartn_isTxIdle). Another interrupt (e.g. of an encoder) wakes the CPU up
+    ///               early. Characters received by the UARTs during the conversion get lost.
+    /// @param[in]    refVoltage  the reference voltage
+    /// @param[in]    channelNo   the number of the channel to convert (0 - 15 or ADC_CH_BANDGAP)
+    /// @param[in]    resolution  the resolution of the result
+    /// @param[out]   pValue      the result
+    /// @retval       1           the CPU slept during the whole conversion
+    /// @retval       0           the CPU was awake during (parts of) the conversion or an error
+    ///                           occurred
+    // ----------------------------------------------------------------------------
+    uint8_t adc_convertSleeping(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution,
+                                uint16_t *pValue);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Adds a channel to the list of the scan sequencer. The list cannot be changed
+    ///               while a scan is running. All channels should use the same reference voltage,
+    ///               since the first conversion after switching the reference is inaccurate.
+    /// @param[in]    refVoltage  the reference voltage
+    /// @param[in]    channelNo   the number of the channel to convert (0 - 15 or ADC_CH_BANDGAP)
+    /// @param[in]    resolution  the resolution of the results
+    /// @return       the index of the channel in the list, which selects its results (see
+    ///               @ref adc_scanGet), or ADC_INVALID
+    // ----------------------------------------------------------------------------
+    uint8_t adc_scanAdd(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Sets the filters of a channel of the scan sequencer. Cannot be called while
+    ///               a scan is running.
+    /// @details      With oversampling, the channel is converted 4^extraBits times in a row per
+    ///               scan; the sum of the conversions is shifted right by extraBits, so that its
+    ///               results have 10 + extraBits bits (8 + extraBits with ADC_RES_8). The median
+    ///               filter then returns the median of the last medianTaps oversampled values.
+    /// @param[in]    index       the index returned by @ref adc_scanAdd
+    /// @param[in]    extraBits   the number of bits gained by oversampling (0 - 3); 0 to disable it
+    /// @param[in]    medianTaps  the length of the median filter (3 or 5); 0 to disable it
+    // ----------------------------------------------------------------------------
+    void adc_scanSetFilter(uint8_t index, uint8_t extraBits, uint8_t medianTaps);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Sets the sampling rate of a channel of the scan sequencer relative to the
+    ///               scan rate. Cannot be called while a scan is running.
+    /// @param[in]    index       the index returned by @ref adc_scanAdd; the first channel of the
+    ///                           list is converted in every scan
+    /// @param[in]    divider     the channel is converted in every divider-th scan (1 - 255)
+    // ----------------------------------------------------------------------------
+    void adc_scanSetDivider(uint8_t index, uint8_t divider);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Stops the scan sequencer and removes all channels from its list.
+    /// @details      The sequencer has a single list and therefore a single owner at a time;
+    ///               libraries that build their own list (e.g. dbIrs.h) refuse to take over a
+    ///               running sequencer (see @ref adc_scanIsRunning).
+    // ----------------------------------------------------------------------------
+    void adc_scanClear();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Starts the scan sequencer.
+    /// @details      With a trigger source of a timer or of INT0, each trigger event starts a scan;
+    ///               events during a scan or while requests are served are ignored. ADC_TS_FREE_RUNNING starts the next scan as
+    ///               soon as the previous one has finished and ADC_TS_SOFTWARE leaves starting the
+    ///               scans to @ref adc_scanTrigger (e.g. from a function of the timebase).
+    ///               A single conversion takes 104us (13 ADC clocks at 125kHz); oversampling
+    ///               multiplies the conversions of a channel by 4^n.
+    /// @param[in]    triggerSource   the source that starts the scans
+    /// @param[in]    callback        the function, which is called by the ADC interrupt once per
+    ///                               completed scan; may be NULL
+    /// @retval       1               the scan sequencer has been started
+    /// @retval       0               no channel has been added or the auto trigger mode is active
+    // ----------------------------------------------------------------------------
+    uint8_t adc_scanStart(ADC_TriggerSource triggerSource, void (*callback)());
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Starts a scan, when the scan sequencer has been started with ADC_TS_SOFTWARE.
+    ///               Can be called by interrupts.
+    /// @retval       1               the scan has been started
+    /// @retval       0               the sequencer is stopped or the previous scan is still running
+    ///                               or pending
+    // ----------------------------------------------------------------------------
+    uint8_t adc_scanTrigger();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Stops the scan sequencer. A running scan is aborted.
+    // ----------------------------------------------------------------------------
+    void adc_scanStop();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the latest result of a channel of the scan sequencer.
+    /// @param[in]    index       the index returned by @ref adc_scanAdd
+    /// @return       the result; 0, if the channel has not been converted yet
+    // ----------------------------------------------------------------------------
+    uint16_t adc_scanGet(uint8_t index);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Copies the buffered results of a channel of the scan sequencer.
+    /// @param[in]    index       the index returned by @ref adc_scanAdd
+    /// @param[out]   pValues     receives up to ADC_SCAN_BUFFER_SIZE results, the oldest first
+    /// @return       the number of results copied
+    // ----------------------------------------------------------------------------
+    uint8_t adc_scanRead(uint8_t index, uint16_t *pValues);
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Returns the number of scans completed since the start of the sequencer.
+    /// @return       the number of scans; wraps around after 65535
+    // ----------------------------------------------------------------------------
+    uint16_t adc_scanGetCount();
+
+    // ----------------------------------------------------------------------------
+    /// @brief        Checks if the scan sequencer has been started.
+    /// @retval       1               the scan sequencer runs
+    /// @retval       0               the scan sequencer is stopped
+    // ----------------------------------------------------------------------------
+    uint8_t adc_scanIsRunning();
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,107 @@
+// ----------------------------------------------------------------------------
+/// @file         daq.h
+/// @addtogroup   DAQ_LIB   DAQ Library (libdaq.a, daq.h)
+/// @{
+/// @brief        The DAQ library samples variables and registers while the program is running
+///               and lets the host change them, e.g. to tune the speed regulation of dbMc.
+/// @details      The host configures up to DAQ_MAX_LISTS lists of up to DAQ_MAX_ENTRIES
+///               address/size pairs, which are sampled together
+///               - by the timebase at a given period (DAQ_EV_TIMER) or
+///               - whenever an event is signaled by @ref daq_event, e.g. at the end of every cycle
+///                 of the speed regulation, when dbMc is compiled with DB_MC_DAQ (DAQ_EV_DBMC).
+///
+///               The entries of a list are copied with interrupts disabled, so that they are
+///               consistent, and sent as a TLM_T_DAQ telemetry record: the list (1 byte), a
+///               counter (1 byte) and the sampled bytes. A list occupies at most
+///               DAQ_MAX_LIST_SIZE bytes, which bounds the time a sample takes.
+///               The commands (see @ref DaqCommand) are received over a channel of the MUX
+///               library (see @ref daq_init) or passed to @ref daq_command by the application;
+///               every command is answered by a TLM_T_DAQ_RESPONSE record: the command (1 byte),
+///               the status (1 byte, see @ref DaqStatus) and the data of the command, if any.
+///               All values are little endian. The host tool tools/daq.py takes the names of
+///               the variables and looks their addresses up in the ELF file.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef DAQ_H_
+#define DAQ_H_
+
+#include <avr/io.h>
+
+#include <tlm.h>
+
+// ----------------------------------------------------------------------------
+/// @brief			  the limits of the lists
+#define DAQ_MAX_LISTS 4
+#define DAQ_MAX_ENTRIES 8
+#define DAQ_MAX_LIST_SIZE (TLM_MAX_PAYLOAD - 2)
+#define DAQ_VERSION 1
+
+// ----------------------------------------------------------------------------
+/// @brief			  the commands; the parameters follow the command byte
+enum DaqCommand
+{
+  DAQ_C_CONNECT = 1,  ///< no parameters; answered by the version and the limits (DAQ_VERSION, DAQ_MAX_LISTS, DAQ_MAX_ENTRIES, DAQ_MAX_LIST_SIZE; uint8_t each)
+  DAQ_C_CLEAR = 2,    ///< list (uint8_t); removes all entries of a stopped list
+  DAQ_C_ADD = 3,      ///< list (uint8_t), address (uint16_t), size (uint8_t); appends an entry to a stopped list
+  DAQ_C_START = 4,    ///< list (uint8_t), event (uint8_t), period (uint16_t); the period is given in milliseconds for DAQ_EV_TIMER, otherwise in events
+  DAQ_C_STOP = 5,     ///< list (uint8_t)
+  DAQ_C_READ = 6,     ///< address (uint16_t), size (uint8_t); answered by the data
+  DAQ_C_WRITE = 7,    ///< address (uint16_t), data; written with interrupts disabled, the highest address first
+  DAQ_C_STOP_ALL = 8  ///< no parameters
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  the status of a response
+enum DaqStatus
+{
+  DAQ_S_OK = 0,        ///< the command has been executed
+  DAQ_S_UNKNOWN = 1,   ///< the command is unknown
+  DAQ_S_INVALID = 2,   ///< a parameter is invalid, e.g. an address outside the SRAM
+  DAQ_S_FULL = 3,      ///< the list has no space for the entry
+  DAQ_S_RUNNING = 4,   ///< the list must be stopped first
+  DAQ_S_TB = 5         ///< the list could not be registered in the timebase
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  the events that trigger the sampling of a list
+enum DaqEvent
+{
+  DAQ_EV_TIMER = 0,  ///< the timebase
+  DAQ_EV_DBMC = 1,   ///< the end of a cycle of dbMc's speed regulation (DB_MC_DAQ)
+  DAQ_EV_USER = 0x80 ///< the events from DAQ_EV_USER on are free for the application
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Initializes the DAQ library, which receives the commands over a channel of
+  ///               the MUX library; the MUX library has to be initialized by @ref mux_init.
+  /// @param[in]    channel         the channel; e.g. MUX_CH_CMD
+  // ----------------------------------------------------------------------------
+  void daq_init(uint8_t channel);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Executes a command and sends the response.
+  /// @param[in]    pData           the command byte followed by the parameters
+  /// @param[in]    length          the number of bytes
+  // ----------------------------------------------------------------------------
+  void daq_command(const uint8_t *pData, uint8_t length);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Signals an event; the lists started with this event are sampled, when their
+  ///               period has elapsed.
+  /// @param[in]    event           the event
+  // ----------------------------------------------------------------------------
+  void daq_event(uint8_t event);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* DAQ_H_ */
+
+/// @}
@@ -4,6 +4,15 @@
 /// @{
 /// @brief        The DB-IRS library provides functions to measure the discbot's distance to other objects
 ///               with the help of infrared sensors
+/// @details      The sensors are converted by the scan sequencer of the ADC library. Every
+///               distance is computed from 4^DB_IRS_OVERSAMPLING conversions (1 extra bit by
+///               default) followed by a median over the last DB_IRS_MEDIAN values (3 by default;
+///               0 disables it), which smoothes the noise of the sensors. While the monitor of the
+///               ADC library runs (see @ref adc_monitorStart), the conversions are corrected to the
+///               supply voltage DB_IRS_VCC_MV (5000mV by default) the distance table refers to.
+///               The library takes over the scan sequencer and replaces its list of channels while
+///               it measures; measurements are refused with an error, as long as another module
+///               runs the sequencer.
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
@@ -12,6 +21,18 @@
 
 #include <avr/io.h>
 
+/// @cond HIDDEN_SYMBOLS
+#ifndef DB_IRS_OVERSAMPLING
+#define DB_IRS_OVERSAMPLING 1
+#endif
+#ifndef DB_IRS_MEDIAN
+#define DB_IRS_MEDIAN 3
+#endif
+#ifndef DB_IRS_VCC_MV
+#define DB_IRS_VCC_MV 5000
+#endif
+/// @endcond
+
 #ifndef DB_DISTANCES
 #define DB_DISTANCES
 
@@ -49,7 +70,9 @@ extern "C"
     uint8_t dbIrs_isInitialized();
 
     // ----------------------------------------------------------------------------
-    /// @brief        Triggers a single distance measurement.
+    /// @brief        Triggers a single distance measurement. Continuous measurements are stopped;
+    ///               the scan sequencer of the ADC library is stopped again, once the distances
+    ///               have been measured.
     /// @param[in]    sensors         sensor(s) to do the measurement. The values DB_IRS_SENSOR_FRONT,
     ///                               DB_IRS_SENSOR_LEFT, DB_IRS_SENSOR_RIGHT, DB_IRS_SENSOR_BACK can
     ///                               be or-ed to measure the distance by several sensors at once.
@@ -4,6 +4,10 @@
 /// @{
 /// @brief        The DB-LEDCAR library provides functions to control the color of the RGB LEDs as
 ///               if the robot were a car.
+/// @details      The indicator is blinked by a function of the timebase, which refreshes the LEDs
+///               within the timer interrupt. When the library is compiled with DB_LED_CAR_DEFERRED
+///               defined, the function is registered with TB_DEFERRED instead and runs in
+///               @ref tb_poll, which the main loop then has to call.
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
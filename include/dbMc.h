@@ -144,6 +144,15 @@ extern "C" {
   // ----------------------------------------------------------------------------
   void dbMc_move(uint16_t distance_mm, int16_t speed, void (*doneCallback)());
 
+  // ----------------------------------------------------------------------------
+  /// @brief        Checks if a maneuver (@ref dbMc_move, @ref dbMc_rotate) or braking (@ref dbMc_brake)
+  ///               is still in progress. This allows to wait for a maneuver without a doneCallback,
+  ///               e.g. with TB_AWAIT (see tbTask.h).
+  /// @retval       0               no maneuver is in progress
+  /// @retval       1               a maneuver is in progress
+  // ----------------------------------------------------------------------------
+  uint8_t dbMc_isBusy();
+
   // ----------------------------------------------------------------------------
   /// @brief        Sets the circumference of the DiscBot's wheels. The value gets stored
   ///               in the EEPROM and will thus be permanent.
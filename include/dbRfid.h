@@ -4,6 +4,10 @@
 /// @{
 /// @brief        The DB-RFID library provides functions to retrieve the id of
 ///               cards by the rfid-reader.
+/// @details      The continuous detection reads the reader via SPI in a function of the
+///               timebase, which blocks the other interrupts for a while. When the library is
+///               compiled with DB_RFID_DEFERRED defined, the function is registered with
+///               TB_DEFERRED instead and runs in @ref tb_poll, which the main loop then has to call.
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
@@ -0,0 +1,96 @@
+// ----------------------------------------------------------------------------
+/// @file         err.h
+/// @addtogroup   ERR_LIB   ERR Library (liberr.a, err.h)
+/// @{
+/// @brief        The ERR library reports errors of the libraries as compact numeric codes.
+/// @details      An error code consists of the module that reports the error (high byte) and the
+///               reason (low byte); see @ref ErrModule and @ref ErrReason. @ref err_report sends it
+///               over UART0 as "E" followed by four hex digits, e.g. "E0E08" for an invalid handle
+///               passed to the timebase. When the library is compiled with ERR_VERBOSE defined, the
+///               names of the module and the reason are appended; they are stored in the flash
+///               memory and do not occupy SRAM. The values of the enums must never be changed,
+///               only new ones appended, since logs are decoded with them.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef ERR_H_
+#define ERR_H_
+
+#include <avr/io.h>
+
+// ----------------------------------------------------------------------------
+/// @brief			  the modules that report errors
+enum ErrModule
+{
+  ERR_M_ADC = 1,      ///< adc
+  ERR_M_DBBTN = 2,    ///< dbBtn
+  ERR_M_DBCS = 3,     ///< dbCs
+  ERR_M_DBIRC = 4,    ///< dbIrc
+  ERR_M_DBIRS = 5,    ///< dbIrs
+  ERR_M_DBLED = 6,    ///< dbLed
+  ERR_M_DBLEDCAR = 7, ///< dbLedCar
+  ERR_M_DBLS = 8,     ///< dbLs
+  ERR_M_DBMC = 9,     ///< dbMc
+  ERR_M_DBRF = 10,    ///< dbRf
+  ERR_M_DBRFID = 11,  ///< dbRfid
+  ERR_M_DBUSS = 12,   ///< dbUss
+  ERR_M_SPI = 13,     ///< spi
+  ERR_M_TB = 14,      ///< tb
+  ERR_M_TBTASK = 15,  ///< tbTask
+  ERR_M_LOG = 16,     ///< log
+  ERR_M_MUX = 17,     ///< mux
+  ERR_M_DAQ = 18      ///< daq
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  the reasons of the errors
+enum ErrReason
+{
+  ERR_R_INIT_MISSING = 1,         ///< the module's init function has not been called
+  ERR_R_ALREADY_INITIALIZED = 2,  ///< the module's init function has been called twice
+  ERR_R_TB_MISSING = 3,           ///< the timebase has not been initialized
+  ERR_R_TB_REGISTER = 4,          ///< a function could not be registered in the timebase
+  ERR_R_NO_SENSOR = 5,            ///< no sensor has been selected
+  ERR_R_NO_MEMORY = 6,            ///< memory could not be allocated
+  ERR_R_INVALID_ARG = 7,          ///< an invalid argument has been passed
+  ERR_R_INVALID_HANDLE = 8,       ///< an invalid or stale handle has been passed
+  ERR_R_NO_SLOT = 9,              ///< all slots are in use
+  ERR_R_INTERRUPTS_DISABLED = 10, ///< the function requires enabled interrupts
+  ERR_R_FAILED = 11               ///< the operation failed
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  composes an error code of a module (@ref ErrModule) and a reason (@ref ErrReason)
+#define ERR_CODE(module, reason) (((uint16_t)(module) << 8) | (reason))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Reports an error over UART0 and stores it as the last error.
+  /// @param[in]    module          the module that reports the error
+  /// @param[in]    reason          the reason of the error
+  // ----------------------------------------------------------------------------
+  void err_report(enum ErrModule module, enum ErrReason reason);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the last reported error and clears it.
+  /// @return       the error code (see @ref ERR_CODE); 0 if no error has been reported
+  // ----------------------------------------------------------------------------
+  uint16_t err_getLast();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of errors reported since the start.
+  /// @return       the number of errors
+  // ----------------------------------------------------------------------------
+  uint16_t err_getCount();
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* ERR_H_ */
+
+/// @}
@@ -0,0 +1,120 @@
+// ----------------------------------------------------------------------------
+/// @file         log.h
+/// @addtogroup   LOG_LIB   LOG Library (liblog.a, log.h)
+/// @{
+/// @brief        The LOG library logs messages, which are formatted on the host.
+/// @details      A message is defined once in logmsg.h by its name, its level and its format.
+///               LOG0(name) to LOG4(name, a, b, c, d) only store the message ID and the raw
+///               16 bit arguments into a ring buffer in the SRAM, which takes a few dozen cycles
+///               and therefore can be done in interrupt service routines as well. Messages whose
+///               level is below the build flag LOG_LEVEL (LOG_INFO by default) are removed by
+///               the compiler completely.
+///               The buffer is drained in the background by a low priority function of the
+///               timebase (see @ref tb_registerEx), which sends the records as TLM_T_LOG
+///               telemetry records over UART0 (see tlm.h). Without the timebase, @ref log_poll has
+///               to be called regularly. A record consists of the message ID (1 byte), the number
+///               of arguments (1 byte) and the arguments (uint16_t, little endian). When the
+///               buffer is full, messages are dropped and reported by the message LOG_DROPPED.
+///               The host tool tools/log_decode.py rebuilds the text from logmsg.h.
+///               The size of the buffer is given by the build flag LOG_BUFFER_SIZE (a power of
+///               2, at most 256; 128 by default).
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <avr/io.h>
+
+// ----------------------------------------------------------------------------
+/// @brief			  the levels of the messages
+#define LOG_DEBUG 0 ///< details for debugging
+#define LOG_INFO 1  ///< normal operation
+#define LOG_WARN 2  ///< unexpected, but handled situations
+#define LOG_ERROR 3 ///< errors
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+// ----------------------------------------------------------------------------
+/// @brief			  the maximum number of 16 bit arguments of a message
+#define LOG_MAX_ARGS 4
+
+// ----------------------------------------------------------------------------
+/// @brief			  the message IDs (LOG_ID_name)
+enum LogId
+{
+#define LOG_MSG(name, level, format) LOG_ID_##name,
+#include "logmsg.h"
+#undef LOG_MSG
+  LOG_ID_COUNT
+};
+
+// the levels of the messages (LOG_LVL_name)
+enum LogLevelOf
+{
+#define LOG_MSG(name, level, format) LOG_LVL_##name = level,
+#include "logmsg.h"
+#undef LOG_MSG
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  splits a 32 bit value into the two arguments required by %ld, %lu and %lx
+#define LOG_U32(value) (uint16_t)(value), (uint16_t)((uint32_t)(value) >> 16)
+
+// ----------------------------------------------------------------------------
+/// @brief			  log a message with 0 to 4 arguments; the number of arguments must match the format
+#define LOG0(name) _LOG(name, 0, 0, 0, 0, 0)
+#define LOG1(name, a) _LOG(name, 1, a, 0, 0, 0)
+#define LOG2(name, a, b) _LOG(name, 2, a, b, 0, 0)
+#define LOG3(name, a, b, c) _LOG(name, 3, a, b, c, 0)
+#define LOG4(name, a, b, c, d) _LOG(name, 4, a, b, c, d)
+
+#define _LOG(name, count, a, b, c, d)                                        \
+  do                                                                         \
+  {                                                                          \
+    if (LOG_LVL_##name >= LOG_LEVEL)                                         \
+      log_put(LOG_ID_##name, count, (uint16_t)(a), (uint16_t)(b), (uint16_t)(c), (uint16_t)(d)); \
+  } while (0)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Initializes the LOG library and registers the function, which drains the
+  ///               buffer, in the timebase. UART0 has to be initialized by @ref tlm_init.
+  ///               Without an initialized timebase, the buffer has to be drained by @ref log_poll.
+  // ----------------------------------------------------------------------------
+  void log_init();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Puts a record into the buffer; use the LOGn macros instead.
+  /// @param[in]    id              the message ID
+  /// @param[in]    count           the number of arguments
+  /// @param[in]    a, b, c, d      the arguments
+  // ----------------------------------------------------------------------------
+  void log_put(uint8_t id, uint8_t count, uint16_t a, uint16_t b, uint16_t c, uint16_t d);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sends the buffered records, as far as there is space in the transmission
+  ///               buffer of UART0.
+  // ----------------------------------------------------------------------------
+  void log_poll();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of messages dropped since the start, since the buffer
+  ///               was full.
+  /// @return       the number of dropped messages
+  // ----------------------------------------------------------------------------
+  uint16_t log_getDropped();
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* LOG_H_ */
+
+/// @}
@@ -0,0 +1,28 @@
+// ----------------------------------------------------------------------------
+/// @file         logmsg.h
+/// @addtogroup   LOG_LIB
+/// @{
+/// @brief        The table of the log messages (see log.h).
+/// @details      Every line LOG_MSG(name, level, format) defines a message, which is logged with
+///               LOGn(name, ...). The message IDs are assigned in the order of the lines, so new
+///               messages must only be appended; the host tool tools/log_decode.py reads this file
+///               to format the records. The format supports %d, %u, %x, %X and %c for 16 bit
+///               arguments and %ld, %lu, %lx, %lX for 32 bit arguments, which occupy two of the
+///               at most LOG_MAX_ARGS arguments (low word first, see LOG_U32).
+///               The application can add own messages in a file, whose name is given by the build
+///               flag LOG_USER_MESSAGES (e.g. -D LOG_USER_MESSAGES=\"appmsg.h\"); its IDs follow
+///               the ones of the library.
+///               This file has no include guard, since it is included several times.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+LOG_MSG(LOG_DROPPED, LOG_WARN, "log: %u messages dropped")
+LOG_MSG(SR04_ECHO, LOG_DEBUG, "sr04: sensor %u, %u mm")
+LOG_MSG(DBMC_TARGET_LEFT, LOG_DEBUG, "dbMc: left wheel reached its target, ocr %u")
+LOG_MSG(DBMC_TARGET_RIGHT, LOG_DEBUG, "dbMc: right wheel reached its target, ocr %u")
+
+#ifdef LOG_USER_MESSAGES
+#include LOG_USER_MESSAGES
+#endif
+
+/// @}
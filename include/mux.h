@@ -0,0 +1,155 @@
+// ----------------------------------------------------------------------------
+/// @file         mux.h
+/// @addtogroup   MUX_LIB   MUX Library (libmux.a, mux.h)
+/// @{
+/// @brief        The MUX library multiplexes several virtual channels over UART0.
+/// @details      Every channel has its own transmission queue in the SRAM. @ref mux_write puts
+///               the data completely into the queue or drops them, so that data written by
+///               interrupts and by the main loop never get mixed up within a channel.
+///               The queues are sent in chunks of up to MUX_CHUNK_SIZE bytes, each as a frame,
+///               which consists of
+///               - the channel number (1 byte),
+///               - the data and
+///               - a CRC-16 (CCITT, polynomial 0x1021, start value 0x1D0F, unlike the TLM frames)
+///                 over all preceding bytes,
+///
+///               COBS encoded and enclosed by 0 bytes like the frames of the TLM library.
+///               The next chunk is taken from the channel with the highest priority (the lowest
+///               value, see @ref mux_setPriority); channels with the same priority take turns.
+///               A channel that has been passed over MUX_MAX_SKIPS times in a row is sent next
+///               anyway, so that high-rate telemetry cannot starve the other channels.
+///               The queues are drained by a low priority function of the timebase (see
+///               @ref tb_registerEx) every millisecond; without the timebase, @ref mux_poll has to
+///               be called regularly. The function stops itself, when all queues are empty and no
+///               receiver is set, and is restarted by the next write, so that a tickless timebase
+///               (TB_TICKLESS) is not woken up every millisecond while nothing is sent. As long as
+///               a receiver is set, UART0 is polled every millisecond, which needs a reception
+///               buffer (build flag UART0_RX_BUFFER_SIZE, e.g. 64) to keep up with the host.
+///               Frames received from the host are passed to the receiver of their channel
+///               (see @ref mux_setReceiver); as long as no receiver is set, the reception of
+///               UART0 is left to the application.
+///               Text sent directly by @ref uartn_msg ends up between the frames and is kept by
+///               the host tool tools/mux_demux.py, which writes every channel as a separate
+///               stream. When the TLM library is compiled with TLM_MUX, its frames are sent over
+///               MUX_CH_TLM, together with the records of the LOG library (see log.h).
+///               The build flags MUX_CHANNELS (4 by default) and MUX_QUEUE_SIZE (a power of 2,
+///               at most 256; 64 bytes per channel by default) set the memory used.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef MUX_H_
+#define MUX_H_
+
+#include <avr/io.h>
+
+/// @cond HIDDEN_SYMBOLS
+#ifndef MUX_CHANNELS
+#define MUX_CHANNELS 4
+#endif
+#ifndef MUX_QUEUE_SIZE
+#define MUX_QUEUE_SIZE 64
+#endif
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief			  the maximum number of data bytes in a frame
+#define MUX_CHUNK_SIZE 32
+
+// ----------------------------------------------------------------------------
+/// @brief			  the number of chunks a waiting channel is passed over at most
+#define MUX_MAX_SKIPS 4
+
+// ----------------------------------------------------------------------------
+/// @brief			  the channels used by the libraries; the channels from MUX_CH_USER up to
+///               MUX_CHANNELS - 1 are free for the application
+enum MuxChannel
+{
+  MUX_CH_TEXT = 0, ///< debug text; priority 2
+  MUX_CH_CMD = 1,  ///< responses to commands; priority 0
+  MUX_CH_TLM = 2,  ///< telemetry (see tlm.h); priority 1
+  MUX_CH_USER = 3  ///< the first channel of the application; priority 2
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Initializes the MUX library and registers the function, which drains the
+  ///               queues, in the timebase. UART0 has to be initialized (e.g. by @ref tlm_init).
+  // ----------------------------------------------------------------------------
+  void mux_init();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sets the priority of a channel.
+  /// @param[in]    channel         the channel
+  /// @param[in]    priority        the priority; 0 is the highest
+  // ----------------------------------------------------------------------------
+  void mux_setPriority(uint8_t channel, uint8_t priority);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Puts data into the queue of a channel. Can be called by interrupts.
+  /// @param[in]    channel         the channel
+  /// @param[in]    pData           the data
+  /// @param[in]    length          the number of bytes
+  /// @retval       1               the data were put into the queue
+  /// @retval       0               the data were dropped, since the queue had not enough space
+  // ----------------------------------------------------------------------------
+  uint8_t mux_write(uint8_t channel, const void *pData, uint8_t length);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Puts a string into the queue of a channel (see @ref mux_write).
+  /// @param[in]    channel         the channel
+  /// @param[in]    pString         the string
+  /// @retval       1               the string was put into the queue
+  /// @retval       0               the string was dropped
+  // ----------------------------------------------------------------------------
+  uint8_t mux_puts(uint8_t channel, const char *pString);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Puts a string stored in the flash memory into the queue of a channel
+  ///               (see @ref mux_write).
+  /// @param[in]    channel         the channel
+  /// @param[in]    pString         the string; must be located in the flash memory
+  /// @retval       1               the string was put into the queue
+  /// @retval       0               the string was dropped
+  // ----------------------------------------------------------------------------
+  uint8_t mux_puts_P(uint8_t channel, const char *pString);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of bytes that fit into the queue of a channel at the moment.
+  /// @param[in]    channel         the channel
+  /// @return       the number of free bytes
+  // ----------------------------------------------------------------------------
+  uint8_t mux_getFree(uint8_t channel);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of bytes of a channel that got dropped, since its queue
+  ///               was full.
+  /// @param[in]    channel         the channel
+  /// @return       the number of dropped bytes
+  // ----------------------------------------------------------------------------
+  uint16_t mux_getDropped(uint8_t channel);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sets the function, which is called for every frame received on a channel.
+  /// @param[in]    channel         the channel
+  /// @param[in]    receiver        the function, which gets the data and their length;
+  ///                               NULL to ignore the channel
+  // ----------------------------------------------------------------------------
+  void mux_setReceiver(uint8_t channel, void (*receiver)(const uint8_t *pData, uint8_t length));
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sends queued chunks, as long as there is space in the transmission buffer
+  ///               of UART0, and passes received frames to their receivers.
+  // ----------------------------------------------------------------------------
+  void mux_poll();
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* MUX_H_ */
+
+/// @}
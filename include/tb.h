@@ -7,6 +7,20 @@
 /// @details      First, the timebase needs to be initialized with @ref tbInit. Afterwards functions can
 ///               be registered that get called by the timebase when their time has come.
 ///               The timebase occupies <b>timer 1</b>, which therefore cannot be used for other purposes.
+///               By default, the memory for the registered functions is allocated on the heap by @ref tb_init.
+///               When the library is compiled with TB_MAX_CALLBACKS defined (e.g. by the build flag
+///               -D TB_MAX_CALLBACKS=16), the memory is allocated statically for TB_MAX_CALLBACKS
+///               functions instead, and the heap is not used at all.
+///               A function takes 13 bytes either way. State, running flag and options share one
+///               byte, but the link of the deadline list, the context pointer, the phase of periodic
+///               functions and the generation of the handle cost 6 bytes, so that a function needs
+///               4 bytes more than the 9 bytes of the first versions of the library.
+///               When the library is compiled with TB_PROFILING defined, the execution time of every
+///               function and of the timer interrupt is measured (see @ref tb_getProfile), which costs
+///               10 additional bytes per function (23 bytes each).
+///               Sleep modes that stop the I/O clock halt timer 1 as well: the timebase then lags
+///               behind by the time slept, e.g. by up to 200us per conversion of
+///               @ref adc_convertSleeping, and is not corrected afterwards.
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
@@ -21,15 +35,41 @@
 /// @brief			  used to set the timebase
 enum TB_BaseTime
 {
-  TB_10MS = 10,   ///< 10 milliseconds
-  TB_20MS = 20,   ///< 20 milliseconds
-  TB_50MS = 50,   ///< 50 milliseconds
-  TB_100MS = 100, ///< 100 milliseconds
-  TB_200MS = 200, ///< 200 milliseconds
-  TB_500MS = 500, ///< 500 milliseconds
-  TB_1S = 1000    ///< 1 second
+  TB_TICKLESS = 1, ///< no fixed basetime; the timer interrupt occurs only when a function's time has come (resolution: 1 millisecond)
+  TB_10MS = 10,    ///< 10 milliseconds
+  TB_20MS = 20,    ///< 20 milliseconds
+  TB_50MS = 50,    ///< 50 milliseconds
+  TB_100MS = 100,  ///< 100 milliseconds
+  TB_200MS = 200,  ///< 200 milliseconds
+  TB_500MS = 500,  ///< 500 milliseconds
+  TB_1S = 1000     ///< 1 second
 };
 
+// ----------------------------------------------------------------------------
+/// @brief			  the handle of a registered function; 0 is never a valid handle. Besides the function's
+///               slot, the handle contains a generation counter; handles of functions that have been
+///               unregistered therefore stay invalid, even when their slot gets reused.
+typedef uint16_t TbHandle;
+
+// ----------------------------------------------------------------------------
+/// @brief			  options for registering a function with @ref tb_registerEx
+#define TB_DEFERRED (1 << 0)     ///< the function is not called by the timer interrupt, but by @ref tb_poll in the main loop
+#define TB_LOW_PRIORITY (1 << 1) ///< the function is called by the timer interrupt with interrupts enabled, after all other functions
+#define TB_PERIODIC (1 << 2)     ///< the function is called on a fixed grid of deadlines; late calls do not delay the following ones
+
+#ifdef TB_PROFILING
+// ----------------------------------------------------------------------------
+/// @brief			  the execution times of a registered function (see @ref tb_getProfile)
+struct TbProfile
+{
+  uint16_t calls;   ///< the number of calls since the registration (stops at 65535)
+  uint32_t min_us;  ///< the shortest execution time in microseconds
+  uint32_t mean_us; ///< the mean execution time in microseconds
+  uint32_t max_us;  ///< the longest execution time in microseconds; saturates at 65535 timer counts
+                    ///< (about 1s, 262ms with TB_TICKLESS)
+};
+#endif
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -43,7 +83,13 @@ extern "C"
   ///                               small value, allows to define more accurate times, but on the other hand
   ///                               consumes more processing power of the CPU. Typical values of baseTime_ms
   ///                               are TB_50MS and TB_100MS (see @ref enum TB_TimeBase).
-  /// @param[in]    maxCallbacks    the maximum number of functions that can be registered
+  ///                               With TB_TICKLESS, timer 1 runs freely and its compare match is set to
+  ///                               the earliest time a function needs to be called (at least every 200ms).
+  ///                               This saves interrupts and allows the CPU to sleep longer. Note, that
+  ///                               timer 1 then runs with a prescaler of 64 instead of 256 and does not
+  ///                               get reset on a compare match.
+  /// @param[in]    maxCallbacks    the maximum number of functions that can be registered; must not exceed
+  ///                               TB_MAX_CALLBACKS, if defined
   /// @retval       1               ok
   /// @retval       0               something went wrong; e.g. the requested memory could not be allocated
   // ----------------------------------------------------------------------------
@@ -58,29 +104,145 @@ extern "C"
 
   // ----------------------------------------------------------------------------
   /// @brief        Returns the time in milliseconds since the timebase got initialized.
+  ///               In periodic mode, the time is a multiple of the basetime; with TB_TICKLESS it is
+  ///               exact to the millisecond.
   /// @return       the time in milliseconds
   // ----------------------------------------------------------------------------
   uint32_t tb_getTime_ms();
 
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of timer 1 counts since the timebase got initialized. The value
+  ///               is read atomically and takes a compare match into account, whose interrupt did
+  ///               not run yet. It can thus be used to measure short durations from interrupts, too.
+  ///               A count lasts 16 microseconds (4 microseconds with TB_TICKLESS).
+  /// @return       the number of counts
+  // ----------------------------------------------------------------------------
+  uint32_t tb_getTicks();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the time in microseconds since the timebase got initialized with the
+  ///               resolution of @ref tb_getTicks. The value overflows after about 71 minutes;
+  ///               differences of two values are nevertheless correct.
+  /// @return       the time in microseconds
+  // ----------------------------------------------------------------------------
+  uint32_t tb_getTime_us();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the time until the next timer interrupt, e.g. to decide whether a sleep
+  ///               mode that stops timer 1 (like SLEEP_MODE_ADC) would delay it.
+  /// @return       the time in microseconds; 0, if the interrupt is pending
+  // ----------------------------------------------------------------------------
+  uint32_t tb_getTimeToInterrupt_us();
+
   // ----------------------------------------------------------------------------
   /// @brief        Returns the timeBase's baseTime in milliseconds.
   /// @return       the baseTime in milliseconds
   // ----------------------------------------------------------------------------
   uint16_t tb_getBaseTime_ms();
 
+  // ----------------------------------------------------------------------------
+  /// @brief        Must be called by the main loop whenever there is nothing else to do, in order
+  ///               to measure the CPU load (see @ref tb_getLoad). tb_idle counts how often it gets
+  ///               called; the less often, the higher the load.
+  // ----------------------------------------------------------------------------
+  void tb_idle();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Determines how often @ref tb_idle is called, when the CPU has nothing else to do.
+  ///               Must be called once after @ref tb_init with interrupts enabled, before other
+  ///               libraries start their work. Takes up to 200 milliseconds (600 milliseconds with
+  ///               TB_TICKLESS).
+  /// @retval       1               ok, the load monitor got calibrated
+  /// @retval       0               something went wrong; e.g. the interrupts were disabled
+  // ----------------------------------------------------------------------------
+  uint8_t tb_calibrateLoad();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the CPU load measured over the last 100 milliseconds (or the time between
+  ///               two timer interrupts, if longer). Requires @ref tb_calibrateLoad and @ref tb_idle.
+  /// @return       the load in percent; 0 if the load monitor is not calibrated
+  // ----------------------------------------------------------------------------
+  uint8_t tb_getLoad();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the highest CPU load of a 100 milliseconds window within the last second.
+  /// @return       the load in percent; 0 if the load monitor is not calibrated
+  // ----------------------------------------------------------------------------
+  uint8_t tb_getPeakLoad();
+
   // ----------------------------------------------------------------------------
   /// @brief        Registers a function to be called in time_ms milliseconds; this starts a timeout for the function which, once reached,
   ///               will call the function. The timeout can be manipulated by @ref tbResetTimeout, @ref tbStopTimeout, @ref tbStartTimeout.
   /// @param[in]    callback        the function to be called. A called function can determine by its return value,
   ///                               whether it shall be called again. If the return value = 0, the function will not
   ///                               be called again, otherwise it will be called in the returned number of miliseconds
-  ///                               The return value must be a multiple a the timebase's basetime.
-  /// @param[in]    time_ms         the function shall be called in time_ms milliseconds. time_ms must be a multiple
-  ///                               of the baseTime_ms set at @ref tbInit.
+  /// @param[in]    time_ms         the function shall be called in time_ms milliseconds (time_ms > 0). If time_ms
+  ///                               is not a multiple of the baseTime_ms set at @ref tbInit, the function is called
+  ///                               on the first tick after time_ms.
   /// @retval       0               the function could not be registered
   /// @retval       >0              the function's handle in the timebase
   // ----------------------------------------------------------------------------
-  uint8_t tb_register(uint16_t (*callback)(), uint16_t time_ms);
+  TbHandle tb_register(uint16_t (*callback)(), uint16_t time_ms);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Registers a function like @ref tb_register, but allows to specify options.
+  /// @details      Functions registered with TB_DEFERRED are not called by the timer interrupt. When
+  ///               their time has come, they are queued and called by @ref tb_poll with interrupts
+  ///               enabled instead. Use this for long-running functions (e.g. SPI, EEPROM or LED
+  ///               accesses), which would otherwise block all other interrupts. Short functions, that
+  ///               need to be called exactly in time (e.g. a speed regulation), should not be deferred.
+  ///               Functions registered with TB_PERIODIC are called at the times t with
+  ///               t % period == phase (t as returned by @ref tb_getTime_ms), where the period is
+  ///               time_ms or the value last returned by the function. Since the deadlines do not
+  ///               depend on the actual calls, late calls (e.g. by @ref tb_poll) do not cause a drift;
+  ///               deadlines that have been missed completely are skipped. The phase is chosen at
+  ///               the registration, so that functions with equal periods are spread over the period
+  ///               instead of being called at the same time; it can be changed with @ref tb_setPhase.
+  ///               Therefore, the first call may happen earlier than time_ms.
+  ///               Functions registered with TB_LOW_PRIORITY are called by the timer interrupt as well,
+  ///               but after all other functions and with interrupts enabled. Other interrupts and
+  ///               the next timer interrupt with its functions can thus interrupt them, which makes
+  ///               TB_LOW_PRIORITY the choice for cosmetic work like playing a song. Functions with
+  ///               timing-critical sequences (e.g. refreshing the ws2812 LEDs, which are bit-banged
+  ///               with interrupts enabled) must not be low-priority. A delay caused by
+  ///               the interruptions adds to the function's period, unless it got registered with
+  ///               TB_PERIODIC. Low-priority functions must be reentrant with respect to the other
+  ///               functions, since they can be interrupted by them.
+  /// @param[in]    callback        the function to be called (see @ref tb_register)
+  /// @param[in]    time_ms         the function shall be called in time_ms milliseconds (see @ref tb_register)
+  /// @param[in]    flags           0 or a combination of TB_DEFERRED or TB_LOW_PRIORITY and TB_PERIODIC
+  /// @retval       0               the function could not be registered
+  /// @retval       >0              the function's handle in the timebase
+  // ----------------------------------------------------------------------------
+  TbHandle tb_registerEx(uint16_t (*callback)(), uint16_t time_ms, uint8_t flags);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Registers a function like @ref tb_register, but the function gets the given
+  ///               context pointer passed on each call. This allows a module to register the same
+  ///               function for several instances, each with its own data.
+  /// @param[in]    callback        the function to be called (see @ref tb_register)
+  /// @param[in]    ctx             the pointer passed to the function
+  /// @param[in]    time_ms         the function shall be called in time_ms milliseconds (see @ref tb_register)
+  /// @retval       0               the function could not be registered
+  /// @retval       >0              the function's handle in the timebase
+  // ----------------------------------------------------------------------------
+  TbHandle tb_registerCtx(uint16_t (*callback)(void *ctx), void *ctx, uint16_t time_ms);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Registers a function with a context pointer (see @ref tb_registerCtx) and
+  ///               options (see @ref tb_registerEx).
+  // ----------------------------------------------------------------------------
+  TbHandle tb_registerCtxEx(uint16_t (*callback)(void *ctx), void *ctx, uint16_t time_ms, uint8_t flags);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Calls the deferred functions (see @ref tb_registerEx), whose time has come.
+  ///               tb_poll must be called regularly from the main loop, as long as deferred
+  ///               functions are registered. The delay between the function's time and the
+  ///               call of tb_poll adds to the function's period, unless it got registered with
+  ///               TB_PERIODIC.
+  /// @return       the number of functions that have been called
+  // ----------------------------------------------------------------------------
+  uint8_t tb_poll();
 
   // ----------------------------------------------------------------------------
   /// @brief        Unregisters a function from the timebase.
@@ -88,7 +250,7 @@ extern "C"
   /// @retval       1               ok, the function was unregistered
   /// @retval       0               the function could not be unregistered
   // ----------------------------------------------------------------------------
-  uint8_t tb_unregister(uint8_t handle);
+  uint8_t tb_unregister(TbHandle handle);
 
   // ----------------------------------------------------------------------------
   /// @brief        Resets the function's timeout.
@@ -96,7 +258,7 @@ extern "C"
   /// @retval       1               ok, the timeout was reset
   /// @retval       0               the timeout could not be reset
   // ----------------------------------------------------------------------------
-  uint8_t tb_resetTimeout(uint8_t handle);
+  uint8_t tb_resetTimeout(TbHandle handle);
 
   // ----------------------------------------------------------------------------
   /// @brief        Stops the function's timeout but does not reset it.
@@ -104,7 +266,7 @@ extern "C"
   /// @retval       1               ok, the timeout was stopped
   /// @retval       0               the timeout could not be stopped
   // ----------------------------------------------------------------------------
-  uint8_t tb_stopTimeout(uint8_t handle);
+  uint8_t tb_stopTimeout(TbHandle handle);
 
   // ----------------------------------------------------------------------------
   /// @brief        Starts the function's timeout, when it got stopped before.
@@ -112,7 +274,52 @@ extern "C"
   /// @retval       1               ok, the timeout was started again
   /// @retval       0               the timeout could not be started
   // ----------------------------------------------------------------------------
-  uint8_t tb_startTimeout(uint8_t handle);
+  uint8_t tb_startTimeout(TbHandle handle);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sets the phase of a function registered with TB_PERIODIC (see @ref tb_registerEx).
+  ///               The function is called next at the first time t with t % period == phase_ms.
+  /// @param[in]    handle          the function's handle obtained when the function got registered (@ref tbRegister).
+  /// @param[in]    phase_ms        the phase in milliseconds; taken modulo the period
+  /// @retval       1               ok, the phase was set
+  /// @retval       0               invalid handle or the function is not periodic
+  // ----------------------------------------------------------------------------
+  uint8_t tb_setPhase(TbHandle handle, uint16_t phase_ms);
+
+#ifdef TB_PROFILING
+  // ----------------------------------------------------------------------------
+  /// @brief        Gets the execution times of a registered function. The resolution is the one of
+  ///               @ref tb_getTicks.
+  /// @param[in]    handle          the function's handle obtained when the function got registered (@ref tbRegister).
+  /// @param[out]   pProfile        the execution times
+  /// @retval       1               ok
+  /// @retval       0               invalid handle
+  // ----------------------------------------------------------------------------
+  uint8_t tb_getProfile(TbHandle handle, struct TbProfile *pProfile);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns how often the timer interrupt took longer than the time up to its next
+  ///               occurrence, i.e. how often deadlines were missed.
+  /// @return       the number of overruns
+  // ----------------------------------------------------------------------------
+  uint16_t tb_getOverruns();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the time spent in the timer interrupt (including the called functions,
+  ///               but without the low-priority ones) per second, measured over the last window of
+  ///               about one second.
+  /// @return       the time in microseconds per second
+  // ----------------------------------------------------------------------------
+  uint32_t tb_getIsrTime_us();
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the longest delay measured from a function's time to its call for the
+  ///               given priority level.
+  /// @param[in]    priority        0 (functions called by the timer interrupt), TB_LOW_PRIORITY or TB_DEFERRED
+  /// @return       the delay in microseconds
+  // ----------------------------------------------------------------------------
+  uint32_t tb_getMaxLatency_us(uint8_t priority);
+#endif
 
 #ifdef __cplusplus
 };
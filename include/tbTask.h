@@ -0,0 +1,143 @@
+// ----------------------------------------------------------------------------
+/// @file         tbTask.h
+/// @addtogroup   TB_TASK_LIB   TB-TASK Library (libtbtask.a, tbTask.h)
+/// @{
+/// @brief        The TB-TASK library allows to write sequential code, that waits for times and
+///               conditions, without blocking the CPU.
+/// @details      A task is a function, which is called by the timebase (see @ref tb.h) and resumes
+///               where it stopped waiting last time. It needs no stack of its own and no heap; the
+///               state of a task is a struct TbTask (6 bytes). Thus, many tasks can run concurrently.
+///               The body of a task is enclosed by TB_TASK_BEGIN and TB_TASK_END. In between,
+///               TB_AWAIT_MS waits for a time, TB_AWAIT for a condition:
+/// @code
+///               uint16_t mission(struct TbTask *task)
+///               {
+///                 TB_TASK_BEGIN(task);
+///                 dbMc_move(500, 50, NULL);
+///                 TB_AWAIT(task, !dbMc_isBusy());
+///                 dbMc_rotate(90, 30, NULL);
+///                 TB_AWAIT(task, !dbMc_isBusy());
+///                 TB_AWAIT_MS(task, 1000);
+///                 TB_TASK_END(task);
+///               }
+///
+///               static struct TbTask missionTask;
+///               tbTask_start(&missionTask, mission, TB_DEFERRED);
+/// @endcode
+///               Since a task returns whenever it waits, local variables lose their values; use
+///               static variables or a struct, which contains the struct TbTask as its first member,
+///               instead. TB_AWAIT and TB_AWAIT_MS must not be used within a switch statement.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef TB_TASK_H_
+#define TB_TASK_H_
+
+#include <avr/io.h>
+#include "tb.h"
+
+// ----------------------------------------------------------------------------
+/// @brief			  the time in milliseconds between two checks of a TB_AWAIT condition
+#ifndef TB_TASK_POLL_MS
+#define TB_TASK_POLL_MS 10
+#endif
+
+// ----------------------------------------------------------------------------
+/// @brief			  the state of a task; must stay valid as long as the task is running
+struct TbTask
+{
+  uint16_t lc;                                ///< the line, where the task resumes; 0 at the beginning
+  TbHandle handle;                            ///< the task's handle in the timebase; 0 if the task is not running
+  uint16_t (*body)(struct TbTask *task);      ///< the task's function
+};
+
+// ----------------------------------------------------------------------------
+/// @brief			  starts the body of a task
+#define TB_TASK_BEGIN(task) \
+  switch ((task)->lc)       \
+  {                         \
+  case 0:
+
+// ----------------------------------------------------------------------------
+/// @brief			  ends the body of a task; the task gets stopped
+#define TB_TASK_END(task) \
+  }                       \
+  (task)->lc = 0;         \
+  (task)->handle = 0;     \
+  return 0
+
+// ----------------------------------------------------------------------------
+/// @brief			  waits for the given time in milliseconds
+#define TB_AWAIT_MS(task, time_ms)             \
+  do                                           \
+  {                                            \
+    (task)->lc = __LINE__;                     \
+    return ((time_ms) > 0) ? (time_ms) : 1;    \
+  case __LINE__:;                              \
+  } while (0)
+
+// ----------------------------------------------------------------------------
+/// @brief			  waits until the given condition is true; the condition is checked every TB_TASK_POLL_MS
+#define TB_AWAIT(task, cond)     \
+  do                             \
+  {                              \
+    (task)->lc = __LINE__;       \
+  case __LINE__:                 \
+    if (!(cond))                 \
+      return TB_TASK_POLL_MS;    \
+  } while (0)
+
+// ----------------------------------------------------------------------------
+/// @brief			  lets other tasks and functions run and continues after TB_TASK_POLL_MS
+#define TB_YIELD(task) TB_AWAIT_MS(task, TB_TASK_POLL_MS)
+
+// ----------------------------------------------------------------------------
+/// @brief			  stops the task from within its body
+#define TB_TASK_EXIT(task) \
+  do                       \
+  {                        \
+    (task)->lc = 0;        \
+    (task)->handle = 0;    \
+    return 0;              \
+  } while (0)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Starts a task, which gets called by the timebase the first time within 1 millisecond
+  ///               (or the timebase's baseTime). A task, that is still running, gets restarted.
+  /// @param[in]    task            the task's state; it must be zeroed (e.g. a static variable), when
+  ///                               the task is started the first time
+  /// @param[in]    body            the task's function
+  /// @param[in]    flags           the options the task is registered with in the timebase (see
+  ///                               @ref tb_registerEx); TB_DEFERRED is recommended for tasks, which
+  ///                               call functions that take long
+  /// @retval       1               ok, the task was started
+  /// @retval       0               the task could not be registered in the timebase
+  // ----------------------------------------------------------------------------
+  uint8_t tbTask_start(struct TbTask *task, uint16_t (*body)(struct TbTask *task), uint8_t flags);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Stops a running task.
+  /// @param[in]    task            the task's state
+  // ----------------------------------------------------------------------------
+  void tbTask_stop(struct TbTask *task);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Checks if a task is running.
+  /// @param[in]    task            the task's state
+  /// @retval       0               the task is not running
+  /// @retval       1               the task is running
+  // ----------------------------------------------------------------------------
+  uint8_t tbTask_isRunning(struct TbTask *task);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* TB_TASK_H_ */
+
+/// @}
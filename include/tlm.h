@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+/// @file         tlm.h
+/// @addtogroup   TLM_LIB   TLM Library (libtlm.a, tlm.h)
+/// @{
+/// @brief        The TLM library sends binary telemetry records over UART0.
+/// @details      Each record is sent as a frame, which consists of
+///               - the record type (1 byte, see @ref TlmType),
+///               - a sequence number (1 byte), which is incremented for every record, even if it
+///                 gets dropped, so that lost records can be detected; a record sent by an
+///                 interrupt can overtake a record, which the main loop is just encoding,
+///               - a timestamp in microseconds (4 bytes, see @ref tb_getTime_us),
+///               - the payload (up to TLM_MAX_PAYLOAD bytes) and
+///               - a CRC-16 (CCITT, polynomial 0x1021, start value 0xFFFF) over all preceding bytes.
+///
+///               All values are little endian. The frame is COBS encoded and enclosed by 0 bytes,
+///               so that a receiver can resynchronize at any time. Text written by @ref uartn_msg
+///               between the frames is discarded by the receiver. The host tool tools/tlm_decode.py
+///               converts a captured byte stream into CSV.
+///               A record is written completely into the transmission buffer of UART0 or dropped, if
+///               there is not enough space; tlm_send never waits. Without the build flag
+///               UART0_TX_BUFFER_SIZE (e.g. 254 when streaming), UART0 sends blocking instead.
+///               The libraries send records themselves, when they are compiled with DB_MC_TELEMETRY
+///               (TLM_T_MC in every cycle of the speed regulation) or DB_CS_TELEMETRY (calibration
+///               data instead of the text dump in dbCs_init).
+///               With the build flag TLM_MUX, the frames are sent over the channel MUX_CH_TLM of
+///               the MUX library (see mux.h) instead; a record is then dropped, when the queue of
+///               that channel is full.
+/// @author       Dietmar Scheiblhofer
+// ----------------------------------------------------------------------------
+
+#ifndef TLM_H_
+#define TLM_H_
+
+#include <avr/io.h>
+
+#include <dbIrs.h>
+#include <dbCs.h>
+
+// ----------------------------------------------------------------------------
+/// @brief			  the maximum size of a record's payload in bytes
+#define TLM_MAX_PAYLOAD 32
+
+// ----------------------------------------------------------------------------
+/// @brief			  the types of the records; the payload's layout is given for each type
+enum TlmType
+{
+  TLM_T_TEXT = 1,          ///< characters
+  TLM_T_USS = 2,           ///< struct DbDistances of the ultrasonic sensors: front, back, left, right (uint8_t, cm)
+  TLM_T_IRS = 3,           ///< struct DbDistances of the infrared sensors: front, back, left, right (uint8_t, cm)
+  TLM_T_COLORS = 4,        ///< struct DbCsColors: left, middle, right, each r, b, c, g (uint8_t)
+  TLM_T_CS_CALIB = 5,      ///< the calibration data of the color sensors (DB_CS_DATA_SIZE * uint16_t)
+  TLM_T_MC = 6,            ///< the speed regulation: target ticks left, right (uint16_t), ticks left, right (int16_t), OCR left, right (uint16_t)
+  TLM_T_CS_COLOR_REF = 7,  ///< a registered color of the color sensors: index (uint8_t), 12 reference values (uint8_t)
+  TLM_T_LOG = 8,           ///< log records (see log.h): message ID (uint8_t), number of arguments (uint8_t), arguments (uint16_t); repeated
+  TLM_T_DAQ = 9,           ///< a sample of a DAQ list (see daq.h): list (uint8_t), counter (uint8_t), the sampled bytes
+  TLM_T_DAQ_RESPONSE = 10, ///< the response to a DAQ command: command (uint8_t), status (uint8_t), data
+  TLM_T_USER = 0x80        ///< the types from TLM_T_USER on are free for the application
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Initializes UART0 for the telemetry.
+  /// @param[in]    baudrate        the baudrate; e.g. 1000000
+  // ----------------------------------------------------------------------------
+  void tlm_init(uint32_t baudrate);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sends a record.
+  /// @param[in]    type            the record's type
+  /// @param[in]    pPayload        the record's payload
+  /// @param[in]    length          the payload's length; at most TLM_MAX_PAYLOAD
+  /// @retval       1               the record was put into the transmission buffer
+  /// @retval       0               the record was dropped
+  // ----------------------------------------------------------------------------
+  uint8_t tlm_send(uint8_t type, const void *pPayload, uint8_t length);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sends the distances measured by the ultrasonic sensors (TLM_T_USS) or the
+  ///               infrared sensors (TLM_T_IRS).
+  /// @param[in]    type            TLM_T_USS or TLM_T_IRS
+  /// @param[in]    pDistances      the distances
+  /// @retval       1               the record was put into the transmission buffer
+  /// @retval       0               the record was dropped
+  // ----------------------------------------------------------------------------
+  uint8_t tlm_sendDistances(uint8_t type, const struct DbDistances *pDistances);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Sends the colors measured by the color sensors (TLM_T_COLORS).
+  /// @param[in]    pColors         the colors
+  /// @retval       1               the record was put into the transmission buffer
+  /// @retval       0               the record was dropped
+  // ----------------------------------------------------------------------------
+  uint8_t tlm_sendColors(const struct DbCsColors *pColors);
+
+  // ----------------------------------------------------------------------------
+  /// @brief        Returns the number of records that got dropped, since the transmission buffer
+  ///               was full.
+  /// @return       the number of dropped records
+  // ----------------------------------------------------------------------------
+  uint16_t tlm_getDropped();
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* TLM_H_ */
+
+/// @}
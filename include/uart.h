@@ -3,7 +3,15 @@
 /// @addtogroup   UART_BASIC_LIB   UART_BASIC Library (libuart_basic.a, uart_basic.h)
 /// @{
 /// @brief        The uart_basic library provides functions to configure UART0-UART3 and functions to send and receive data.
-///               The library does NOT support interrupt-driven data exchange.
+///               A UART sends and receives interrupt-driven via ring buffers, when the build flags
+///               UARTn_TX_BUFFER_SIZE and UARTn_RX_BUFFER_SIZE (n=0..3, at most 254 characters each)
+///               set the buffer sizes, so that sending does not block the CPU, as long as the
+///               transmission buffer does not run full. All sizes are 0 by default, which keeps the
+///               polled, blocking mode and leaves the USARTn interrupt vectors to the application;
+///               a size above 0 defines USARTn_UDRE_vect or USARTn_RX_vect in this library.
+///               Characters that are sent with interrupts disabled (e.g. from an ISR) while the
+///               transmission buffer is full get dropped and counted instead of blocking
+///               (see @ref uartn_getTxOverflows).
 /// @author       Dietmar Scheiblhofer
 // ----------------------------------------------------------------------------
 
@@ -18,6 +26,33 @@
 
 #include <avr/io.h>
 
+/// @cond HIDDEN_SYMBOLS
+#ifndef UART0_TX_BUFFER_SIZE
+#define UART0_TX_BUFFER_SIZE 0
+#endif
+#ifndef UART0_RX_BUFFER_SIZE
+#define UART0_RX_BUFFER_SIZE 0
+#endif
+#ifndef UART1_TX_BUFFER_SIZE
+#define UART1_TX_BUFFER_SIZE 0
+#endif
+#ifndef UART1_RX_BUFFER_SIZE
+#define UART1_RX_BUFFER_SIZE 0
+#endif
+#ifndef UART2_TX_BUFFER_SIZE
+#define UART2_TX_BUFFER_SIZE 0
+#endif
+#ifndef UART2_RX_BUFFER_SIZE
+#define UART2_RX_BUFFER_SIZE 0
+#endif
+#ifndef UART3_TX_BUFFER_SIZE
+#define UART3_TX_BUFFER_SIZE 0
+#endif
+#ifndef UART3_RX_BUFFER_SIZE
+#define UART3_RX_BUFFER_SIZE 0
+#endif
+/// @endcond
+
 // ----------------------------------------------------------------------------
 /// @brief			  used to set the UART's parity mode
 enum UartParity
@@ -38,6 +73,45 @@ enum UartMode
 };
 // ----------------------------------------------------------------------------
 
+// ----------------------------------------------------------------------------
+/// @brief			  the maximum baud rate error in per mille accepted by @ref UART_BAUD; may be set by
+///               a build flag. 115200 baud at 16 MHz has an error of 2.1% and needs 25.
+#ifndef UART_BAUD_TOLERANCE
+#define UART_BAUD_TOLERANCE 20
+#endif
+
+/// @cond HIDDEN_SYMBOLS
+#define UART_SETTING_U2X (1 << 15) // the flag of the double speed mode in a baud rate setting
+#define _UART_DIV(baud, div) ((uint32_t)(div) * (uint32_t)(baud))
+#define _UART_UBRR(baud, div) ((F_CPU + _UART_DIV(baud, div) / 2) / _UART_DIV(baud, div) - 1)
+#define _UART_CLOCKS(baud, div) (_UART_DIV(baud, div) * (_UART_UBRR(baud, div) + 1)) // F_CPU, if there is no error
+#define _UART_DEV(baud, div) (F_CPU > _UART_CLOCKS(baud, div) ? F_CPU - _UART_CLOCKS(baud, div) : _UART_CLOCKS(baud, div) - F_CPU)
+#define _UART_USE_U2X(baud) \
+    (_UART_UBRR(baud, 8) <= 4095 && (_UART_UBRR(baud, 16) > 4095 || _UART_DEV(baud, 8) < _UART_DEV(baud, 16)))
+#define _UART_DIVISOR(baud) (_UART_USE_U2X(baud) ? 8 : 16)
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief			  computes the baud rate setting (UBRR and the double speed mode U2X) for
+///               @ref uartn_initBaud at compile time, without checking the error. The double speed
+///               mode is only used, when it gives a smaller error.
+#define UART_SETTING(baud) \
+    ((uint16_t)(_UART_USE_U2X(baud) ? (_UART_UBRR(baud, 8) | UART_SETTING_U2X) : _UART_UBRR(baud, 16)))
+
+// ----------------------------------------------------------------------------
+/// @brief			  the error of the baud rate generated for the given baud rate in per mille
+#define UART_BAUD_ERROR(baud) \
+    ((uint16_t)((unsigned long long)_UART_DEV(baud, _UART_DIVISOR(baud)) * 1000 / _UART_CLOCKS(baud, _UART_DIVISOR(baud))))
+
+// ----------------------------------------------------------------------------
+/// @brief			  like @ref UART_SETTING, but the compilation fails ("size of array is negative"),
+///               when the error exceeds UART_BAUD_TOLERANCE or the baud rate cannot be generated;
+///               e.g. uart0_initBaud(UART_BAUD(1000000), UART_M_TRANSCEIVE, UART_P_NONE)
+#define UART_BAUD(baud)                                                                                 \
+    ((uint16_t)(sizeof(char[(UART_BAUD_ERROR(baud) <= UART_BAUD_TOLERANCE &&                          \
+                             _UART_UBRR(baud, _UART_DIVISOR(baud)) <= 4095) ? 1 : -1]) * 0 + \
+                UART_SETTING(baud)))
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -45,6 +119,9 @@ extern "C"
 
 // ----------------------------------------------------------------------------
 /// @brief        Configures UARTx for data reception and/or data transmission in asynchronous mode with 8 data and 2 stop bits.
+///               The baud rate setting is computed with integer arithmetic; the double speed mode
+///               is used, when it gives a smaller error. If the baud rate is known at compile time,
+///               @ref uartn_initBaud with @ref UART_BAUD avoids the computation and checks the error.
 /// @param[in]    baudrate        the baudrate
 /// @param[in]    mode            the mode
 /// @param[in]    parity          the parity configuration
@@ -60,7 +137,25 @@ extern "C"
 /// @endcond
 
 // ----------------------------------------------------------------------------
-/// @brief        Waits until the transmission buffer of UARTx is empty and sends the given character.
+/// @brief        Configures UARTx like @ref uartn_init with a baud rate setting computed at
+///               compile time.
+/// @param[in]    setting         the baud rate setting; UART_BAUD(baudrate) or UART_SETTING(baudrate)
+/// @param[in]    mode            the mode
+/// @param[in]    parity          the parity configuration
+// ----------------------------------------------------------------------------
+#if 0
+  void uartn_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity);
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    void uart0_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity);
+    void uart1_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity);
+    void uart2_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity);
+    void uart3_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity);
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Sends the given character. Waits until there is space in the transmission buffer of UARTx.
+///               With interrupts disabled and a ring buffer, the character is dropped instead.
 /// @param[in]    c               the character to send
 // ----------------------------------------------------------------------------
 #if 0
@@ -74,9 +169,8 @@ extern "C"
 /// @endcond
 
 // ----------------------------------------------------------------------------
-/// @brief        Sends the given string over UARTx. uartn_puts is a blocking
-///               function which means that it waits until all characters of
-///               the string have been sent.
+/// @brief        Sends the given string over UARTx. uartn_puts waits until all characters of
+///               the string have been put into the transmission buffer (see @ref uartn_putc).
 /// @param[in]    pString         the string to send
 // ----------------------------------------------------------------------------
 #if 0
@@ -89,6 +183,39 @@ extern "C"
     void uart3_puts(char *pString);
 /// @endcond
 
+// ----------------------------------------------------------------------------
+/// @brief        Puts as many of the given characters into the transmission buffer of UARTx
+///               as fit, without waiting. Without a transmission buffer, all characters are sent
+///               blocking.
+/// @param[in]    pData           the characters to send
+/// @param[in]    length          the number of characters
+/// @return       the number of characters accepted
+// ----------------------------------------------------------------------------
+#if 0
+  uint8_t uartn_write(const char *pData, uint8_t length);
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint8_t uart0_write(const char *pData, uint8_t length);
+    uint8_t uart1_write(const char *pData, uint8_t length);
+    uint8_t uart2_write(const char *pData, uint8_t length);
+    uint8_t uart3_write(const char *pData, uint8_t length);
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Returns the number of characters that fit into the transmission buffer of UARTx
+///               at the moment, i.e. that @ref uartn_write would accept.
+/// @return       the number of free characters; 255 without a transmission buffer
+// ----------------------------------------------------------------------------
+#if 0
+  uint8_t uartn_getTxFree();
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint8_t uart0_getTxFree();
+    uint8_t uart1_getTxFree();
+    uint8_t uart2_getTxFree();
+    uint8_t uart3_getTxFree();
+/// @endcond
+
 // ----------------------------------------------------------------------------
 /// @brief        Waits until a character has been received by UARTx and returns the character.
 /// @return       the received character
@@ -119,6 +246,69 @@ extern "C"
     uint8_t uart3_getc_nb(char *pData);
 /// @endcond
 
+// ----------------------------------------------------------------------------
+/// @brief        Gets up to length received characters, without waiting.
+/// @param[out]   pData           the received characters
+/// @param[in]    length          the maximum number of characters
+/// @return       the number of characters received
+// ----------------------------------------------------------------------------
+#if 0
+  uint8_t uartn_read(char *pData, uint8_t length);
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint8_t uart0_read(char *pData, uint8_t length);
+    uint8_t uart1_read(char *pData, uint8_t length);
+    uint8_t uart2_read(char *pData, uint8_t length);
+    uint8_t uart3_read(char *pData, uint8_t length);
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Checks, if UARTx has sent all characters completely, i.e. the transmission buffer
+///               and the shift register are empty (e.g. before the I/O clock gets stopped by a sleep
+///               mode).
+/// @retval       1   the transmitter is idle
+/// @retval       0   characters are being sent
+// ----------------------------------------------------------------------------
+#if 0
+  uint8_t uartn_isTxIdle();
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint8_t uart0_isTxIdle();
+    uint8_t uart1_isTxIdle();
+    uint8_t uart2_isTxIdle();
+    uint8_t uart3_isTxIdle();
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Returns the number of characters that got dropped, since the transmission buffer
+///               was full while interrupts were disabled.
+/// @return       the number of dropped characters
+// ----------------------------------------------------------------------------
+#if 0
+  uint16_t uartn_getTxOverflows();
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint16_t uart0_getTxOverflows();
+    uint16_t uart1_getTxOverflows();
+    uint16_t uart2_getTxOverflows();
+    uint16_t uart3_getTxOverflows();
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Returns the number of received characters that got lost, since the reception
+///               buffer was full or the interrupt came too late.
+/// @return       the number of lost characters
+// ----------------------------------------------------------------------------
+#if 0
+  uint16_t uartn_getRxOverflows();
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    uint16_t uart0_getRxOverflows();
+    uint16_t uart1_getRxOverflows();
+    uint16_t uart2_getRxOverflows();
+    uint16_t uart3_getRxOverflows();
+/// @endcond
+
 // ----------------------------------------------------------------------------
 /// @brief        Sends the given string over UART0. If the UART has not been
 ///               initialized yet, it will be set to 115200 Baud and no parity
@@ -132,6 +322,36 @@ extern "C"
     void uart1_msg(char *pString);
     void uart2_msg(char *pString);
     void uart3_msg(char *pString);
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Sends the given string, which is stored in the flash memory, over UARTx
+///               (see @ref uartn_puts). Strings declared with PSTR("...") or PROGMEM do not
+///               occupy SRAM.
+/// @param[in]    pString         the string to send; must be located in the flash memory
+// ----------------------------------------------------------------------------
+#if 0
+  void uartn_puts_P(const char *pString);
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    void uart0_puts_P(const char *pString);
+    void uart1_puts_P(const char *pString);
+    void uart2_puts_P(const char *pString);
+    void uart3_puts_P(const char *pString);
+/// @endcond
+
+// ----------------------------------------------------------------------------
+/// @brief        Sends the given string, which is stored in the flash memory, like @ref uartn_msg.
+/// @param[in]    pString         the string to send; must be located in the flash memory
+// ----------------------------------------------------------------------------
+#if 0
+  void uartn_msg_P(const char *pString);
+#endif
+    /// @cond HIDDEN_SYMBOLS
+    void uart0_msg_P(const char *pString);
+    void uart1_msg_P(const char *pString);
+    void uart2_msg_P(const char *pString);
+    void uart3_msg_P(const char *pString);
     /// @endcond
 
 #ifdef __cplusplus
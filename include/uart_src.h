@@ -1,6 +1,21 @@
 static uint8_t uartx_initialized = 0;
+static volatile uint8_t uartx_txActive = 0; // a character has been written into UDRx; TXC0 tells its end
+
+#if UARTx_TX_SIZE > 0
+static char uartx_txData[UARTx_TX_SIZE + 1]; // one element stays free to tell a full from an empty buffer
+static struct UartRing uartx_tx = {uartx_txData, UARTx_TX_SIZE + 1, 0, 0, 0};
+#endif
+#if UARTx_RX_SIZE > 0
+static char uartx_rxData[UARTx_RX_SIZE + 1];
+static struct UartRing uartx_rx = {uartx_rxData, UARTx_RX_SIZE + 1, 0, 0, 0};
+#endif
 
 void uartx_init(uint32_t baudrate, enum UartMode mode, enum UartParity parity)
+{
+    uartx_initBaud(_uart_setting(baudrate), mode, parity);
+}
+
+void uartx_initBaud(uint16_t setting, enum UartMode mode, enum UartParity parity)
 {
     uartx_initialized = 1;
 
@@ -8,17 +23,23 @@ void uartx_init(uint32_t baudrate, enum UartMode mode, enum UartParity parity)
     UCSRxA = 0; // clears all bits and U2X0 for single transmission speed
 
     UCSRxB = 0;                               // clears all bits and UCSZ02 for 8 data bits
+                                              // and disables the interrupts
     UCSRxC = ((1 << USBS0) |                  // 2 stop bits
               (1 << UCSZ01) | (1 << UCSZ00)); // 8 data bits
                                               // clears all other bits for async mode
 
+#if UARTx_TX_SIZE > 0
+    uartx_tx.in = uartx_tx.out = 0; // discard the characters that have not been sent yet
+#endif
+    uartx_txActive = 0;
+#if UARTx_RX_SIZE > 0
+    uartx_rx.in = uartx_rx.out = 0;
+#endif
+
     // set the baudrate
-    if (baudrate > 57600)
-    {
-        baudrate /= 2;
+    if (setting & UART_SETTING_U2X)
         UCSRxA |= (1 << U2X0);
-    }
-    UBRRx = round(F_CPU / 16 / (double)baudrate) - 1; // set baudrate
+    UBRRx = setting & ~UART_SETTING_U2X;
 
     // set the mode
     switch (mode)
@@ -43,6 +64,11 @@ void uartx_init(uint32_t baudrate, enum UartMode mode, enum UartParity parity)
     }
     }
 
+#if UARTx_RX_SIZE > 0
+    if (UCSRxB & (1 << RXEN0))
+        UCSRxB |= (1 << RXCIE0); // the received characters are stored by the interrupt
+#endif
+
     // set the parity configuration
     switch (parity)
     {
@@ -66,28 +92,121 @@ void uartx_init(uint32_t baudrate, enum UartMode mode, enum UartParity parity)
     }
 }
 
+#if UARTx_TX_SIZE > 0
+ISR(UARTx_UDRE_vect)
+{
+    char c;
+
+    if (_uart_ringGet(&uartx_tx, &c))
+    {
+        UCSRxA = (UCSRxA & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0); // cleared, until c has been sent
+        uartx_txActive = 1;
+        UDRx = c;
+    }
+    else
+        UCSRxB &= ~(1 << UDRIE0); // nothing left to send
+}
+
+void uartx_putc(char c)
+{
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    while (!_uart_ringPut(&uartx_tx, c))
+    {
+        if (!bit) // called with interrupts disabled (e.g. from an ISR); waiting would block
+        {
+            uartx_tx.overflows++;
+            return;
+        }
+        sei(); // let the interrupt empty the transmission buffer; the instruction after sei
+        _NOP(); // is always executed before a pending interrupt, so cli must not follow directly
+        cli();
+    }
+    UCSRxB |= (1 << UDRIE0); // start the transmission, if it is not running yet
+    if (bit)
+        sei();
+}
+
+uint8_t uartx_write(const char *pData, uint8_t length)
+{
+    uint8_t i;
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    for (i = 0; i < length; i++)
+    {
+        if (!_uart_ringPut(&uartx_tx, pData[i]))
+            break;
+    }
+    if (i)
+        UCSRxB |= (1 << UDRIE0);
+    if (bit)
+        sei();
+    return i;
+}
+#else
 void uartx_putc(char c)
 {
     while (!(UCSRxA & (1 << UDRE0)))
         ;     // wait until the UDRE0 bit has been set. This
               // indicates that the transmission buffer is ready
               // for another character to send
+    UCSRxA = (UCSRxA & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0); // cleared, until c has been sent
+    uartx_txActive = 1;
     UDRx = c; // put the character into the transmission buffer
 }
 
+uint8_t uartx_write(const char *pData, uint8_t length)
+{
+    uint8_t i;
+
+    for (i = 0; i < length; i++)
+        uartx_putc(pData[i]); // without a transmission buffer, the characters are sent right away
+    return length;
+}
+#endif
+
 void uartx_puts(char *pString)
 {
     while (*pString != '\0') // as long as there are characters left
                              // the end of the string is indicated by '\0'
     {
-        while (!(UCSRxA & (1 << UDRE0)))
-            ;            // wait until the transmission buffer is ready
-                         // for the next character
-        UDRx = *pString; // copy the character into the transmission buffer
-        pString++;       // continue with the next character
+        uartx_putc(*pString); // copy the character into the transmission buffer
+        pString++;            // continue with the next character
     }
 }
 
+#if UARTx_RX_SIZE > 0
+ISR(UARTx_RX_vect)
+{
+    if (UCSRxA & (1 << DOR0)) // a character got lost in the hardware, before this interrupt ran
+        uartx_rx.overflows++;
+    if (!_uart_ringPut(&uartx_rx, UDRx))
+        uartx_rx.overflows++;
+}
+
+char uartx_getc()
+{
+    char c;
+
+    while (!uartx_getc_nb(&c))
+        ; // wait until a character has been received
+    return c;
+}
+
+uint8_t uartx_getc_nb(char *pData)
+{
+    uint8_t result;
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    result = _uart_ringGet(&uartx_rx, pData);
+    if (bit)
+        sei();
+    return result;
+}
+#else
 char uartx_getc()
 {
     while (!(UCSRxA & (1 << RXC0)))
@@ -105,12 +224,103 @@ uint8_t uartx_getc_nb(char *pData)
     *pData = UDRx;
     return 1;
 }
+#endif
+
+uint8_t uartx_read(char *pData, uint8_t length)
+{
+    uint8_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        if (!uartx_getc_nb(&pData[i]))
+            break;
+    }
+    return i;
+}
+
+uint8_t uartx_getTxFree()
+{
+#if UARTx_TX_SIZE > 0
+    uint8_t in, out;
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    in = uartx_tx.in;
+    out = uartx_tx.out;
+    if (bit)
+        sei();
+    return (out > in) ? out - in - 1 : UARTx_TX_SIZE - (in - out);
+#else
+    return 0xFF; // characters are sent blocking, so there is always space
+#endif
+}
+
+uint8_t uartx_isTxIdle()
+{
+#if UARTx_TX_SIZE > 0
+    if (uartx_tx.in != uartx_tx.out)
+        return 0; // characters are waiting in the transmission buffer
+#endif
+    return !uartx_txActive || (UCSRxA & (1 << TXC0));
+}
+
+uint16_t uartx_getTxOverflows()
+{
+#if UARTx_TX_SIZE > 0
+    uint16_t overflows;
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    overflows = uartx_tx.overflows;
+    if (bit)
+        sei();
+    return overflows;
+#else
+    return 0;
+#endif
+}
+
+uint16_t uartx_getRxOverflows()
+{
+#if UARTx_RX_SIZE > 0
+    uint16_t overflows;
+    uint8_t bit = bit_is_set(SREG, 7);
+
+    cli();
+    overflows = uartx_rx.overflows;
+    if (bit)
+        sei();
+    return overflows;
+#else
+    return 0;
+#endif
+}
+
+void uartx_puts_P(const char *pString)
+{
+    char c;
+
+    while ((c = pgm_read_byte(pString)) != '\0') // the string stays in the flash memory
+    {
+        uartx_putc(c);
+        pString++;
+    }
+}
 
 void uartx_msg(char *pString)
 {
     if (!uartx_initialized)
     {
-        uartx_init(115200, UART_M_TRANSCEIVE, UART_P_NONE);
+        uartx_initBaud(UART_SETTING(115200), UART_M_TRANSCEIVE, UART_P_NONE);
     }
     uartx_puts(pString);
 }
+
+void uartx_msg_P(const char *pString)
+{
+    if (!uartx_initialized)
+    {
+        uartx_initBaud(UART_SETTING(115200), UART_M_TRANSCEIVE, UART_P_NONE);
+    }
+    uartx_puts_P(pString);
+}
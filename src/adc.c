@@ -1,22 +1,132 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/cpufunc.h>
+#include <avr/sleep.h>
 #include <stdlib.h>
 
 #include "adc.h"
+#include <err.h>
+#include <tb.h>
 #include <uart.h>
 
-static uint8_t (*adc_callback8)(uint8_t) = NULL;
-static uint8_t (*adc_callback10)(uint16_t) = NULL;
+#if (ADC_SCAN_BUFFER_SIZE > 128) || (ADC_SCAN_BUFFER_SIZE & (ADC_SCAN_BUFFER_SIZE - 1))
+#error "ADC_SCAN_BUFFER_SIZE must be a power of 2 and must not exceed 128"
+#endif
+#if (ADC_QUEUE_SIZE > 128) || (ADC_QUEUE_SIZE & (ADC_QUEUE_SIZE - 1))
+#error "ADC_QUEUE_SIZE must be a power of 2 and must not exceed 128"
+#endif
+
+// the owner of the ADC interrupt
+enum AdcState
+{
+    ADC_STATE_IDLE = 0,    // no conversion; the ADC is turned off, unless a scan is started
+    ADC_STATE_ARMED = 1,   // the trigger source starts the next scan
+    ADC_STATE_SCAN = 2,    // a channel of the scan sequencer is converted
+    ADC_STATE_REQUEST = 3, // the first request of the queue is converted
+    ADC_STATE_AUTO = 4,    // adc_autoTrigger8 or adc_autoTrigger10 owns the ADC
+    ADC_STATE_SLEEP = 5,   // adc_convertSleeping waits for its conversion
+    ADC_STATE_CAPTURE = 6  // free-running conversions fill the capture buffers
+};
+
 static void (*adc_callbackAuto8)(uint8_t) = NULL;
 static void (*adc_callbackAuto10)(uint16_t) = NULL;
 
+static volatile uint8_t _adc_state = ADC_STATE_IDLE;
+static uint8_t _adc_selectedAdmux = 0;  // the channel selected by adc_selectChannel
+static uint8_t _adc_selectedAdcsrb = 0;
+
+struct AdcScanSlot
+{
+    uint8_t admux;                          // the ADMUX value of the channel
+    uint8_t adcsrb;                         // the MUX5 bit of the channel
+    uint8_t head;                           // the index of the next result in the buffer
+    uint8_t count;                          // the number of results in the buffer
+    uint16_t values[ADC_SCAN_BUFFER_SIZE];  // the latest results
+    uint8_t extraBits;                      // the bits gained by oversampling (0 - 3)
+    uint8_t samples;                        // the number of samples in the accumulator
+    uint16_t sum;                           // the accumulator of the oversampling
+    uint8_t medianTaps;                     // the length of the median filter (0, 3 or 5)
+    uint8_t medianCount;                    // the number of values in the median window
+    uint8_t medianHead;                     // the index of the next value in the median window
+    uint16_t median[5];                     // the median window
+    uint8_t divider;                        // the channel is converted every divider-th scan
+    uint8_t countdown;                      // the number of scans to skip until the next conversion
+};
+
+static struct AdcScanSlot _adc_scanSlots[ADC_SCAN_CHANNELS];
+static uint8_t _adc_scanChannels = 0;       // the number of channels in the list
+static volatile uint8_t _adc_scanIndex = 0; // the channel being converted
+static volatile uint8_t _adc_scanRunning = 0;
+static volatile uint8_t _adc_scanPending = 0; // adc_scanTrigger was called while requests were served
+static volatile uint16_t _adc_scanCount = 0;
+static ADC_TriggerSource _adc_scanTriggerSource = ADC_TS_SOFTWARE;
+static void (*_adc_scanCallback)() = NULL;
+
+struct AdcRequest
+{
+    uint8_t admux;     // the ADMUX value of the channel
+    uint8_t adcsrb;    // the MUX5 bit of the channel
+    uint8_t client;    // the client, whose statistics are updated
+    uint8_t selected;  // 1 for adc_trigger8 and adc_trigger10, which follow adc_selectChannel
+    uint16_t time_us;  // the time of the submission (lower 16 bits)
+    uint8_t (*callback)(uint16_t value);
+    uint8_t (*callback8)(uint8_t value); // the callback passed to adc_trigger8 instead
+};
+
+struct AdcClient
+{
+    uint16_t requests;       // the number of completed requests
+    uint16_t dropped;        // the number of requests rejected, since the queue was full
+    uint16_t minLatency_us;
+    uint16_t maxLatency_us;
+    uint32_t sumLatency_us;
+};
+
+static uint8_t *_adc_captureBuffers = NULL;          // both capture buffers, one after the other
+static uint16_t _adc_captureLength = 0;              // the length of a capture buffer
+static uint8_t *_adc_capturePtr = NULL;              // the next sample
+static uint8_t *_adc_captureEnd = NULL;              // the end of the buffer being filled
+static uint8_t *volatile _adc_captureReady = NULL;   // the full buffer until its release
+static volatile uint16_t _adc_captureOverruns = 0;
+static void (*_adc_captureCallback)(const uint8_t *pBuffer, uint16_t length) = NULL;
+
+static volatile uint8_t _adc_sleepWaiting = 0; // adc_convertSleeping waits for the ADC
+static volatile uint8_t _adc_sleepDone = 0;    // the conversion of adc_convertSleeping is complete
+static volatile uint16_t _adc_sleepValue = 0;
+
+static struct AdcRequest _adc_queue[ADC_QUEUE_SIZE];
+static volatile uint8_t _adc_queueHead = 0;  // the request being converted next
+static volatile uint8_t _adc_queueCount = 0;
+static struct AdcClient _adc_clients[ADC_CLIENTS];
+static uint8_t _adc_clientCount = 1;         // client 0 stands for adc_trigger8 and adc_trigger10
+
+struct AdcBatteryAlarm
+{
+    uint16_t threshold_mV;
+    uint8_t low;                           // the battery voltage is below the threshold
+    void (*callback)(uint16_t battery_mV);
+};
+
+static TbHandle _adc_monHandle = 0;
+static uint8_t _adc_monClient = ADC_INVALID;
+static uint8_t _adc_monChannel = ADC_INVALID;  // the channel of the battery divider
+static uint16_t _adc_monRatio_permille = 1000; // the battery voltage per voltage at the channel
+static uint16_t _adc_monPeriod_ms = 0;
+static volatile uint16_t _adc_monBandgap = 0;  // the latest conversions
+static volatile uint16_t _adc_monBattery = 0;
+static volatile uint8_t _adc_monFresh = 0;     // bit 0: new bandgap conversion; bit 1: new battery conversion
+static uint16_t _adc_vcc_mV = 0;
+static uint16_t _adc_battery_mV = 0;
+static struct AdcBatteryAlarm _adc_alarms[ADC_BATTERY_ALARMS];
+static uint8_t _adc_alarmCount = 0;
+
 static uint8_t _adc_initialized = 0;
 
 static uint8_t adc_isInitialized()
 {
     if (!_adc_initialized)
     {
-        uart0_msg("adc: adc_init missing\n");
+        err_report(ERR_M_ADC, ERR_R_INIT_MISSING);
         return 0;
     }
     return 1;
@@ -26,11 +136,162 @@ void adc_init()
 {
     if (_adc_initialized)
     {
-        uart0_msg("adc: already initialized\n");
+        err_report(ERR_M_ADC, ERR_R_ALREADY_INITIALIZED);
     }
     _adc_initialized = 1;
 }
 
+// returns the ADMUX and ADCSRB values of a channel
+static void _adc_channel(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution,
+                         uint8_t *pAdmux, uint8_t *pAdcsrb)
+{
+    *pAdmux = (refVoltage << REFS0) | ((channelNo == ADC_CH_BANDGAP ? 0x1E : (channelNo & 0x07)) << MUX0);
+    if (resolution == ADC_RES_8)
+    {
+        *pAdmux |= (1 << ADLAR); // the upper 8 bits are read from ADCH
+    }
+    *pAdcsrb = (channelNo > 7 && channelNo <= 15) ? (1 << MUX5) : 0;
+}
+
+// checks the number of a channel
+static inline uint8_t _adc_isChannel(uint8_t channelNo)
+{
+    return channelNo <= 15 || channelNo == ADC_CH_BANDGAP;
+}
+
+// selects a channel for the next conversion
+static inline void _adc_select(uint8_t admux, uint8_t adcsrb)
+{
+    ADMUX = admux;
+    ADCSRB = (ADCSRB & ~(1 << MUX5)) | adcsrb;
+}
+
+// clears the flag of the trigger source, so that its next event starts a conversion
+static void _adc_clearTriggerFlag(ADC_TriggerSource triggerSource)
+{
+    switch (triggerSource)
+    {
+    case ADC_TS_INT0:
+        EIFR = (1 << INTF0);
+        break;
+    case ADC_TS_TIMER0_COMPA:
+        TIFR0 = (1 << OCF0A);
+        break;
+    case ADC_TS_TIMER0_OVF:
+        TIFR0 = (1 << TOV0);
+        break;
+    case ADC_TS_TIMER1_COMPB:
+        TIFR1 = (1 << OCF1B);
+        break;
+    case ADC_TS_TIMER1_OVF:
+        TIFR1 = (1 << TOV1);
+        break;
+    default:
+        break;
+    }
+}
+
+// starts the first channel of a scan; the first channel is converted in every scan
+static void _adc_startScan()
+{
+    _adc_scanIndex = 0;
+    _adc_select(_adc_scanSlots[0].admux, _adc_scanSlots[0].adcsrb);
+    _adc_state = ADC_STATE_SCAN;
+    ADCSRA = (ADCSRA & ~(1 << ADATE)) | (1 << ADSC);
+}
+
+// hands the ADC over to the next user, once it got free; called with disabled interrupts
+static void _adc_next()
+{
+    if (_adc_sleepWaiting) // adc_convertSleeping takes over
+    {
+        _adc_state = ADC_STATE_IDLE;
+        return;
+    }
+
+    if (_adc_queueCount)
+    {
+        struct AdcRequest *pRequest = &_adc_queue[_adc_queueHead];
+
+        _adc_select(pRequest->admux, pRequest->adcsrb);
+        _adc_state = ADC_STATE_REQUEST;
+        ADCSRA = (ADCSRA & ~(1 << ADATE)) | (1 << ADSC); // requests follow each other immediately
+        return;
+    }
+
+    if (_adc_scanRunning)
+    {
+        if (_adc_scanTriggerSource == ADC_TS_FREE_RUNNING || _adc_scanPending)
+        {
+            _adc_scanPending = 0;
+            _adc_startScan();
+        }
+        else if (_adc_scanTriggerSource != ADC_TS_SOFTWARE)
+        {
+            _adc_scanIndex = 0;
+            _adc_select(_adc_scanSlots[0].admux, _adc_scanSlots[0].adcsrb);
+            _adc_state = ADC_STATE_ARMED;
+            _adc_clearTriggerFlag(_adc_scanTriggerSource); // events before are ignored
+            ADCSRA |= (1 << ADATE);                       // the trigger source starts the next scan
+        }
+        else
+        {
+            _adc_state = ADC_STATE_IDLE;
+        }
+        return;
+    }
+
+    _adc_state = ADC_STATE_IDLE;
+    ADCSRA &= ~(1 << ADEN); // turn off the ADC
+}
+
+// turns on the ADC without starting a conversion
+static void _adc_enable()
+{
+    ADCSRA = (1 << ADEN) | // enable the ADC
+             (1 << ADIE) | // enable the ADC interrupt
+             (7 << ADPS0); // set the clock divider to 128
+}
+
+// puts a request into the queue and starts it, if the ADC is free; called with disabled interrupts
+static uint8_t _adc_submit(struct AdcRequest *pRequest)
+{
+    if (_adc_queueCount >= ADC_QUEUE_SIZE || _adc_state == ADC_STATE_AUTO) // the auto trigger mode owns the ADC
+    {
+        if (_adc_clients[pRequest->client].dropped < 0xFFFF)
+        {
+            _adc_clients[pRequest->client].dropped++;
+        }
+        return 0;
+    }
+
+    pRequest->time_us = tb_isInitialized() ? (uint16_t)tb_getTime_us() : 0;
+    _adc_queue[(_adc_queueHead + _adc_queueCount) & (ADC_QUEUE_SIZE - 1)] = *pRequest;
+    _adc_queueCount++;
+
+    switch (_adc_state)
+    {
+    case ADC_STATE_IDLE:
+        _adc_enable();
+        _adc_next();
+        break;
+    case ADC_STATE_ARMED:
+        ADCSRA &= ~(1 << ADATE);
+        if (ADCSRA & (1 << ADSC)) // the trigger has just started the scan
+        {
+            _adc_state = ADC_STATE_SCAN;
+        }
+        else
+        {
+            _adc_next();
+        }
+        break;
+    default: // served after the running conversion or scan
+        break;
+    }
+    return 1;
+}
+
 void adc_selectChannel(ADC_RefVoltage refVoltage, uint8_t channelNo)
 {
     if (!adc_isInitialized())
@@ -38,18 +299,36 @@ void adc_selectChannel(ADC_RefVoltage refVoltage, uint8_t channelNo)
         return;
     }
 
-    ADMUX = ((ADMUX & 0x3F) | // set the reference voltage
-             (refVoltage << REFS0));
+    if (_adc_isChannel(channelNo))
+    {
+        _adc_channel(refVoltage, channelNo, ADC_RES_10, &_adc_selectedAdmux, &_adc_selectedAdcsrb);
+    }
+}
+
+// queues a conversion of the selected channel for adc_trigger8 and adc_trigger10
+static void _adc_triggerSelected(uint8_t (*callback)(uint16_t value), uint8_t (*callback8)(uint8_t value))
+{
+    struct AdcRequest request;
+
+    request.admux = _adc_selectedAdmux | (callback8 ? (1 << ADLAR) : 0); // left aligned for 8 bits
+    request.adcsrb = _adc_selectedAdcsrb;
+    request.client = 0;
+    request.selected = 1;
+    request.callback = callback;
+    request.callback8 = callback8;
 
-    if (channelNo <= 7) // select the desired channel
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (!_adc_submit(&request))
     {
-        ADMUX = ((ADMUX & 0xE0) | (channelNo << MUX0));
-        ADCSRB &= ~(1 << MUX5);
+        err_report(ERR_M_ADC, _adc_state == ADC_STATE_AUTO ? ERR_R_FAILED : ERR_R_NO_SLOT);
     }
-    else if (channelNo <= 15)
+    if (bit)
     {
-        ADMUX = ((ADMUX & 0xE0) | ((channelNo - 8) << MUX0));
-        ADCSRB |= (1 << MUX5);
+        sei();
     }
 }
 
@@ -60,40 +339,49 @@ void adc_trigger8(uint8_t (*callback)(uint8_t value))
         return;
     }
 
-    ADMUX |= (1 << ADLAR); // the result needs to be left aligned to
-    // get 8-bit resolution
-    ADCSRA = (1 << ADEN) | // enable the ADC
-             (1 << ADIE) | // enable the ADC interrupt
-             (7 << ADPS0); // set the clock divider to 128
-    adc_callbackAuto8 = NULL;
-    adc_callbackAuto10 = NULL;
-    adc_callback8 = callback; // remember the callback
-    adc_callback10 = NULL;
-    ADCSRA |= (1 << ADSC); // start a conversion
+    _adc_triggerSelected(NULL, callback);
 
     sei();
 }
 
-void adc_autoTrigger8(ADC_TriggerSource triggerSource, void (*callback)(uint8_t value))
+// switches the ADC to the auto trigger mode, unless other users need it
+static uint8_t _adc_startAuto(ADC_TriggerSource triggerSource, uint8_t admux)
 {
-    if (!adc_isInitialized())
+    if (triggerSource == ADC_TS_SOFTWARE)
     {
-        return;
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+    if (_adc_scanRunning || _adc_queueCount || (_adc_state != ADC_STATE_IDLE && _adc_state != ADC_STATE_AUTO))
+    {
+        err_report(ERR_M_ADC, ERR_R_FAILED); // the auto trigger mode needs the ADC exclusively
+        return 0;
     }
 
-    ADMUX |= (1 << ADLAR); // the result needs to be left aligned to
-    // get 8-bit resolution
+    _adc_state = ADC_STATE_AUTO;
+    _adc_select(admux, _adc_selectedAdcsrb);
     ADCSRA = (1 << ADEN) |              // enable the ADC
              (1 << ADIE) |              // enable the ADC interrupt
              (7 << ADPS0) |             // set the clock divider to 128
              (1 << ADATE);              // enable automatic trigger
     ADCSRB &= ~(7 << ADTS0);            // clear the trigger source bits
     ADCSRB |= (triggerSource << ADTS0); // set the trigger source bits
+    return 1;
+}
+
+void adc_autoTrigger8(ADC_TriggerSource triggerSource, void (*callback)(uint8_t value))
+{
+    if (!adc_isInitialized())
+    {
+        return;
+    }
 
-    adc_callbackAuto8 = callback;
-    adc_callbackAuto10 = NULL;
-    adc_callback8 = NULL; // remember the callback
-    adc_callback10 = NULL;
+    cli();
+    if (_adc_startAuto(triggerSource, _adc_selectedAdmux | (1 << ADLAR))) // the result needs to be
+    {                                                                       // left aligned to get 8 bits
+        adc_callbackAuto8 = callback; // remember the callback
+        adc_callbackAuto10 = NULL;
+    }
 
     sei();
 }
@@ -105,16 +393,7 @@ void adc_trigger10(uint8_t (*callback)(uint16_t value))
         return;
     }
 
-    ADMUX &= ~(1 << ADLAR); // the result needs to be right aligned to
-    // get the full (=10-bit) resolution
-    ADCSRA = (1 << ADEN) | // enable the ADC
-             (1 << ADIE) | // enable the ADC interrupt
-             (7 << ADPS0); // set the clock divider to 128
-    adc_callbackAuto8 = NULL;
-    adc_callbackAuto10 = NULL;
-    adc_callback8 = NULL;
-    adc_callback10 = callback; // remember the callback
-    ADCSRA |= (1 << ADSC);     // start a conversion
+    _adc_triggerSelected(callback, NULL);
 
     sei();
 }
@@ -126,47 +405,983 @@ void adc_autoTrigger10(ADC_TriggerSource triggerSource, void (*callback)(uint16_
         return;
     }
 
-    ADMUX &= ~(1 << ADLAR); // the result needs to be left aligned to
-    // get 8-bit resolution
-    ADCSRA = (1 << ADEN) |              // enable the ADC
-             (1 << ADIE) |              // enable the ADC interrupt
-             (7 << ADPS0) |             // set the clock divider to 128
-             (1 << ADATE);              // enable automatic trigger
-    ADCSRB &= ~(7 << ADTS0);            // clear the trigger source bits
-    ADCSRB |= (triggerSource << ADTS0); // set the trigger source bits
+    cli();
+    if (_adc_startAuto(triggerSource, _adc_selectedAdmux)) // right aligned for the full 10 bits
+    {
+        adc_callbackAuto8 = NULL;
+        adc_callbackAuto10 = callback; // remember the callback
+    }
+
+    sei();
+}
+
+void adc_autoStop()
+{
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_state == ADC_STATE_AUTO)
+    {
+        adc_callbackAuto8 = NULL;
+        adc_callbackAuto10 = NULL;
+        ADCSRA = 0;
+        _adc_state = ADC_STATE_IDLE;
+    }
+    if (bit)
+    {
+        sei();
+    }
+}
 
-    adc_callbackAuto8 = NULL;
-    adc_callbackAuto10 = callback;
-    adc_callback8 = NULL; // remember the callback
-    adc_callback10 = NULL;
+uint8_t adc_captureStart(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Prescaler prescaler, uint8_t *pBuffers,
+                         uint16_t length, void (*callback)(const uint8_t *pBuffer, uint16_t length))
+{
+    uint8_t admux, adcsrb;
+    uint8_t started = 0;
 
+    if (!adc_isInitialized())
+    {
+        return 0;
+    }
+    if (!_adc_isChannel(channelNo) || prescaler < ADC_PS_2 || prescaler > ADC_PS_128 || !pBuffers || !length)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+
+    _adc_channel(refVoltage, channelNo, ADC_RES_8, &admux, &adcsrb);
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_scanRunning || _adc_queueCount ||
+        (_adc_state != ADC_STATE_IDLE && _adc_state != ADC_STATE_CAPTURE))
+    {
+        err_report(ERR_M_ADC, ERR_R_FAILED); // the capture needs the ADC exclusively
+    }
+    else
+    {
+        ADCSRA = 0; // ends a running capture
+
+        _adc_captureBuffers = pBuffers;
+        _adc_captureLength = length;
+        _adc_capturePtr = pBuffers;
+        _adc_captureEnd = pBuffers + length;
+        _adc_captureReady = NULL;
+        _adc_captureOverruns = 0;
+        _adc_captureCallback = callback;
+        _adc_state = ADC_STATE_CAPTURE;
+
+        _adc_select(admux, adcsrb);
+        ADCSRB &= ~(7 << ADTS0);         // free running
+        ADCSRA = (1 << ADEN) |           // enable the ADC
+                 (1 << ADIE) |           // enable the ADC interrupt
+                 (prescaler << ADPS0) |  // set the clock divider
+                 (1 << ADATE) |          // convert continuously
+                 (1 << ADSC);            // start the first conversion
+        started = 1;
+    }
+    if (bit)
+    {
+        sei();
+    }
+
+    return started;
+}
+
+const uint8_t *adc_captureGet()
+{
+    const uint8_t *pBuffer;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    pBuffer = _adc_captureReady; // the pointer is written by the ADC interrupt
+    if (bit)
+    {
+        sei();
+    }
+
+    return pBuffer;
+}
+
+void adc_captureRelease()
+{
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    _adc_captureReady = NULL; // a half-cleared pointer would count as an overrun
+    if (bit)
+    {
+        sei();
+    }
+}
+
+uint16_t adc_captureGetOverruns()
+{
+    uint16_t overruns;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    overruns = _adc_captureOverruns;
+    if (bit)
+    {
+        sei();
+    }
+
+    return overruns;
+}
+
+void adc_captureStop()
+{
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_state == ADC_STATE_CAPTURE)
+    {
+        ADCSRA = 0; // aborts the running conversion
+        _adc_enable();
+        _adc_next(); // serves the requests and scans that waited for the ADC
+    }
+    if (bit)
+    {
+        sei();
+    }
+}
+
+uint8_t adc_registerClient()
+{
+    if (!adc_isInitialized())
+    {
+        return ADC_INVALID;
+    }
+    if (_adc_clientCount >= ADC_CLIENTS)
+    {
+        err_report(ERR_M_ADC, ERR_R_NO_SLOT);
+        return ADC_INVALID;
+    }
+
+    return _adc_clientCount++;
+}
+
+uint8_t adc_request(uint8_t client, ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution,
+                    uint8_t (*callback)(uint16_t value))
+{
+    struct AdcRequest request;
+    uint8_t queued;
+
+    if (!adc_isInitialized())
+    {
+        return 0;
+    }
+    if (client >= _adc_clientCount || !_adc_isChannel(channelNo) || !callback)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+
+    _adc_channel(refVoltage, channelNo, resolution, &request.admux, &request.adcsrb);
+    request.client = client;
+    request.selected = 0;
+    request.callback = callback;
+    request.callback8 = NULL;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    queued = _adc_submit(&request);
+    if (!queued && _adc_state == ADC_STATE_AUTO)
+    {
+        err_report(ERR_M_ADC, ERR_R_FAILED);
+    }
+    if (bit)
+    {
+        sei();
+    }
+
+    return queued;
+}
+
+uint8_t adc_getClientStats(uint8_t client, struct AdcClientStats *pStats)
+{
+    if (client >= _adc_clientCount)
+    {
+        return 0;
+    }
+
+    const struct AdcClient *pClient = &_adc_clients[client];
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    pStats->requests = pClient->requests;
+    pStats->dropped = pClient->dropped;
+    pStats->min_us = pClient->minLatency_us;
+    pStats->max_us = pClient->maxLatency_us;
+    pStats->mean_us = pClient->requests ? pClient->sumLatency_us / pClient->requests : 0;
+    if (bit)
+    {
+        sei();
+    }
+
+    return 1;
+}
+
+// discards the first conversion after switching to the bandgap, which needs time to settle
+static uint8_t _adc_monDiscard(uint16_t value)
+{
+    return 0;
+}
+
+static uint8_t _adc_monBandgapMeasured(uint16_t value)
+{
+    _adc_monBandgap = value;
+    _adc_monFresh |= 1;
+    return 0;
+}
+
+static uint8_t _adc_monBatteryMeasured(uint16_t value)
+{
+    _adc_monBattery = value;
+    _adc_monFresh |= 2;
+    return 0;
+}
+
+// calls the callbacks of the thresholds the battery voltage has fallen below
+static void _adc_monCheckAlarms(uint16_t battery_mV)
+{
+    for (uint8_t i = 0; i < _adc_alarmCount; i++)
+    {
+        struct AdcBatteryAlarm *pAlarm = &_adc_alarms[i];
+
+        if (!pAlarm->low && battery_mV < pAlarm->threshold_mV)
+        {
+            pAlarm->low = 1;
+            pAlarm->callback(battery_mV);
+        }
+        else if (pAlarm->low && battery_mV >= pAlarm->threshold_mV + ADC_BATTERY_HYSTERESIS_MV)
+        {
+            pAlarm->low = 0; // rearmed
+        }
+    }
+}
+
+// low-priority function of the timebase; evaluates the last conversions and requests the next ones
+static uint16_t _adc_monitor()
+{
+    struct AdcRequest request;
+    uint16_t bandgap, battery;
+    uint32_t value_mV;
+    uint8_t fresh;
+
+    cli();
+    fresh = _adc_monFresh;
+    _adc_monFresh = 0;
+    bandgap = _adc_monBandgap;
+    battery = _adc_monBattery;
     sei();
+
+    if ((fresh & 1) && bandgap)
+    {
+        value_mV = (uint32_t)ADC_BANDGAP_MV * 1024 / bandgap;
+        cli();
+        _adc_vcc_mV = _adc_vcc_mV ? (3 * (uint32_t)_adc_vcc_mV + value_mV) / 4 : value_mV; // low pass
+        sei();
+    }
+    if ((fresh & 2) && _adc_vcc_mV)
+    {
+        value_mV = ((uint32_t)battery * _adc_vcc_mV >> 10) * _adc_monRatio_permille / 1000;
+        cli();
+        _adc_battery_mV = _adc_battery_mV ? (3 * (uint32_t)_adc_battery_mV + value_mV) / 4 : value_mV;
+        sei();
+        _adc_monCheckAlarms(_adc_battery_mV);
+    }
+
+    _adc_channel(ADC_AVCC, ADC_CH_BANDGAP, ADC_RES_10, &request.admux, &request.adcsrb);
+    request.client = _adc_monClient;
+    request.selected = 0;
+    request.callback8 = NULL;
+
+    cli(); // the requests follow each other directly, so that the bandgap stays selected
+    request.callback = _adc_monDiscard;
+    _adc_submit(&request);
+    request.callback = _adc_monBandgapMeasured;
+    _adc_submit(&request);
+    if (_adc_monChannel != ADC_INVALID)
+    {
+        _adc_channel(ADC_AVCC, _adc_monChannel, ADC_RES_10, &request.admux, &request.adcsrb);
+        request.callback = _adc_monBatteryMeasured;
+        _adc_submit(&request);
+    }
+    sei();
+
+    return _adc_monPeriod_ms;
 }
 
-ISR(ADC_vect)
+void adc_monitorStart(uint8_t batteryChannel, uint16_t ratio_permille, uint16_t period_ms)
 {
-    uint8_t retVal = 0;
+    if (!adc_isInitialized())
+    {
+        return;
+    }
+    if ((batteryChannel != ADC_INVALID && batteryChannel > 15) || !ratio_permille || !period_ms)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return;
+    }
+    if (!tb_isInitialized())
+    {
+        err_report(ERR_M_ADC, ERR_R_TB_MISSING);
+        return;
+    }
+
+    adc_monitorStop();
+    if (_adc_monClient == ADC_INVALID)
+    {
+        _adc_monClient = adc_registerClient();
+        if (_adc_monClient == ADC_INVALID)
+        {
+            _adc_monClient = ADC_CLIENT_DEFAULT;
+        }
+    }
+
+    _adc_monChannel = batteryChannel;
+    _adc_monRatio_permille = ratio_permille;
+    _adc_monPeriod_ms = period_ms;
+    _adc_vcc_mV = 0;
+    _adc_battery_mV = 0;
+    for (uint8_t i = 0; i < _adc_alarmCount; i++)
+    {
+        _adc_alarms[i].low = 0;
+    }
+
+    _adc_monHandle = tb_registerEx(_adc_monitor, period_ms, TB_PERIODIC | TB_LOW_PRIORITY);
+    if (!_adc_monHandle)
+    {
+        err_report(ERR_M_ADC, ERR_R_TB_REGISTER);
+    }
+}
+
+void adc_monitorStop()
+{
+    if (_adc_monHandle)
+    {
+        tb_unregister(_adc_monHandle);
+        _adc_monHandle = 0;
+    }
+}
+
+uint8_t adc_addLowBatteryCallback(uint16_t threshold_mV, void (*callback)(uint16_t battery_mV))
+{
+    if (!callback)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+    if (_adc_alarmCount >= ADC_BATTERY_ALARMS)
+    {
+        err_report(ERR_M_ADC, ERR_R_NO_SLOT);
+        return 0;
+    }
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    _adc_alarms[_adc_alarmCount].threshold_mV = threshold_mV;
+    _adc_alarms[_adc_alarmCount].low = 0;
+    _adc_alarms[_adc_alarmCount].callback = callback;
+    _adc_alarmCount++;
+    if (bit)
+    {
+        sei();
+    }
+
+    return 1;
+}
+
+uint16_t adc_getVcc_mV()
+{
+    uint16_t vcc_mV;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    vcc_mV = _adc_vcc_mV;
+    if (bit)
+    {
+        sei();
+    }
+
+    return vcc_mV;
+}
+
+uint16_t adc_getBattery_mV()
+{
+    uint16_t battery_mV;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    battery_mV = _adc_battery_mV;
+    if (bit)
+    {
+        sei();
+    }
+
+    return battery_mV;
+}
+
+uint8_t adc_convertSleeping(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution,
+                            uint16_t *pValue)
+{
+    uint8_t admux, adcsrb, smcr;
+    uint8_t quiet = 0;
+    uint32_t conversion_us;
 
-    if (adc_callback8)
-        retVal = (*adc_callback8)(ADCH);
-    if (adc_callback10)
-        retVal = (*adc_callback10)(ADC);
-    if (adc_callbackAuto8)
+    if (!adc_isInitialized())
+    {
+        return 0;
+    }
+    if (!_adc_isChannel(channelNo))
     {
-        (*adc_callbackAuto8)(ADCH);
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+    if (!bit_is_set(SREG, 7)) // the ADC interrupt has to wake up the CPU
+    {
+        err_report(ERR_M_ADC, ERR_R_INTERRUPTS_DISABLED);
+        return 0;
+    }
+
+    _adc_channel(refVoltage, channelNo, resolution, &admux, &adcsrb);
+
+    cli();
+    if (_adc_state == ADC_STATE_AUTO || _adc_state == ADC_STATE_CAPTURE) // would never finish
+    {
+        sei();
+        err_report(ERR_M_ADC, ERR_R_FAILED);
+        return 0;
+    }
+    _adc_sleepWaiting = 1;
+    while (1) // wait, until the running request or scan has finished
+    {
+        if (_adc_state == ADC_STATE_ARMED)
+        {
+            ADCSRA &= ~(1 << ADATE); // re-armed, once the conversion is complete
+            if (ADCSRA & (1 << ADSC))
+            {
+                _adc_state = ADC_STATE_SCAN; // the trigger has just started the scan
+            }
+        }
+        if (_adc_state == ADC_STATE_IDLE || _adc_state == ADC_STATE_ARMED)
+        {
+            break;
+        }
+        sei();  // the instruction after sei is always executed before a pending interrupt,
+        _NOP(); // so that the ADC interrupt would never run, if cli followed directly
+        cli();
+    }
+
+    // the first conversion after enabling the ADC takes 25 instead of 13 ADC clocks of 8us
+    conversion_us = (ADCSRA & (1 << ADEN)) ? 13 * 8 : 25 * 8;
+    _adc_enable();
+    _adc_select(admux, adcsrb);
+    _adc_state = ADC_STATE_SLEEP;
+    _adc_sleepWaiting = 0;
+    _adc_sleepDone = 0;
+
+    // the sleep mode stops the clock of the UARTs, which would corrupt a character being sent
+    if (uart0_isTxIdle() &&
+        (!tb_isInitialized() || tb_getTimeToInterrupt_us() > conversion_us + ADC_SLEEP_MARGIN_US))
+    {
+        smcr = SMCR;
+        set_sleep_mode(SLEEP_MODE_ADC);
+        sleep_enable();
+        sei();
+        sleep_cpu(); // entering the sleep mode starts the conversion
+        sleep_disable();
+        SMCR = smcr;
+        quiet = _adc_sleepDone; // otherwise, another interrupt woke up the CPU
+    }
+    else
+    {
+        ADCSRA |= (1 << ADSC); // a deadline of the timebase is imminent or UART0 is sending
+        sei();
+    }
+
+    while (!_adc_sleepDone)
+        ;
+    *pValue = _adc_sleepValue;
+
+    return quiet;
+}
+
+uint8_t adc_scanAdd(ADC_RefVoltage refVoltage, uint8_t channelNo, ADC_Resolution resolution)
+{
+    struct AdcScanSlot *pSlot;
+
+    if (!adc_isInitialized())
+    {
+        return ADC_INVALID;
+    }
+    if (!_adc_isChannel(channelNo) || _adc_scanRunning)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return ADC_INVALID;
+    }
+    if (_adc_scanChannels >= ADC_SCAN_CHANNELS)
+    {
+        err_report(ERR_M_ADC, ERR_R_NO_SLOT);
+        return ADC_INVALID;
+    }
+
+    pSlot = &_adc_scanSlots[_adc_scanChannels];
+    _adc_channel(refVoltage, channelNo, resolution, &pSlot->admux, &pSlot->adcsrb);
+    pSlot->head = 0;
+    pSlot->count = 0;
+    pSlot->values[0] = 0;
+    pSlot->extraBits = 0;
+    pSlot->medianTaps = 0;
+    pSlot->divider = 1;
+
+    return _adc_scanChannels++;
+}
+
+void adc_scanSetFilter(uint8_t index, uint8_t extraBits, uint8_t medianTaps)
+{
+    if (index >= _adc_scanChannels || _adc_scanRunning || extraBits > 3 ||
+        (medianTaps != 0 && medianTaps != 3 && medianTaps != 5))
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
         return;
     }
-    if (adc_callbackAuto10)
+
+    _adc_scanSlots[index].extraBits = extraBits;
+    _adc_scanSlots[index].medianTaps = medianTaps;
+}
+
+void adc_scanSetDivider(uint8_t index, uint8_t divider)
+{
+    if (index >= _adc_scanChannels || _adc_scanRunning || divider == 0 || (index == 0 && divider != 1))
     {
-        (*adc_callbackAuto10)(ADC);
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
         return;
     }
-    if (retVal) // when the callback function returned 1
+
+    _adc_scanSlots[index].divider = divider;
+}
+
+void adc_scanClear()
+{
+    adc_scanStop();
+    _adc_scanChannels = 0;
+}
+
+uint8_t adc_scanStart(ADC_TriggerSource triggerSource, void (*callback)())
+{
+    if (!adc_isInitialized())
+    {
+        return 0;
+    }
+    if (!_adc_scanChannels)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+
+    adc_scanStop(); // a running scan is aborted
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_state == ADC_STATE_AUTO) // the auto trigger mode owns the ADC
+    {
+        if (bit)
+        {
+            sei();
+        }
+        err_report(ERR_M_ADC, ERR_R_FAILED);
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < _adc_scanChannels; i++)
+    {
+        _adc_scanSlots[i].samples = 0;
+        _adc_scanSlots[i].sum = 0;
+        _adc_scanSlots[i].medianCount = 0;
+        _adc_scanSlots[i].medianHead = 0;
+        _adc_scanSlots[i].countdown = 0;
+    }
+
+    _adc_scanTriggerSource = triggerSource;
+    _adc_scanCallback = callback;
+    _adc_scanPending = 0;
+    _adc_scanCount = 0;
+    if (triggerSource != ADC_TS_FREE_RUNNING && triggerSource != ADC_TS_SOFTWARE)
+    {
+        ADCSRB = (ADCSRB & ~(7 << ADTS0)) | (triggerSource << ADTS0);
+    }
+    _adc_scanRunning = 1;
+
+    if (_adc_state == ADC_STATE_IDLE) // otherwise, the scan starts after the running request
+    {
+        _adc_enable();
+        _adc_next();
+    }
+
+    if (bit)
+    {
+        sei();
+    }
+
+    return 1;
+}
+
+uint8_t adc_scanTrigger()
+{
+    uint8_t started = 0;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_scanRunning && _adc_scanTriggerSource == ADC_TS_SOFTWARE && !_adc_scanPending &&
+        _adc_state != ADC_STATE_SCAN)
+    {
+        if (_adc_state == ADC_STATE_IDLE && !_adc_sleepWaiting)
+        {
+            _adc_startScan();
+        }
+        else
+        {
+            _adc_scanPending = 1; // started after the queued requests
+        }
+        started = 1;
+    }
+    if (bit)
+    {
+        sei();
+    }
+
+    return started;
+}
+
+void adc_scanStop()
+{
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    if (_adc_scanRunning)
+    {
+        _adc_scanRunning = 0;
+        _adc_scanPending = 0;
+        if (_adc_state == ADC_STATE_SCAN || _adc_state == ADC_STATE_ARMED)
+        {
+            ADCSRA = 0; // aborts a running conversion
+            _adc_enable();
+            _adc_next(); // serves the queued requests or turns off the ADC
+        }
+        else if (_adc_state == ADC_STATE_IDLE)
+        {
+            ADCSRA &= ~(1 << ADEN);
+        }
+    }
+    if (bit)
+    {
+        sei();
+    }
+}
+
+uint16_t adc_scanGet(uint8_t index)
+{
+    uint16_t value;
+
+    if (index >= _adc_scanChannels)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+
+    const struct AdcScanSlot *pSlot = &_adc_scanSlots[index];
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    value = pSlot->values[(pSlot->head - 1) & (ADC_SCAN_BUFFER_SIZE - 1)];
+    if (!pSlot->count)
+    {
+        value = 0;
+    }
+    if (bit)
+    {
+        sei();
+    }
+
+    return value;
+}
+
+uint8_t adc_scanRead(uint8_t index, uint16_t *pValues)
+{
+    uint8_t count;
+
+    if (index >= _adc_scanChannels)
+    {
+        err_report(ERR_M_ADC, ERR_R_INVALID_ARG);
+        return 0;
+    }
+
+    const struct AdcScanSlot *pSlot = &_adc_scanSlots[index];
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    count = pSlot->count;
+    uint8_t pos = pSlot->head - count;
+    for (uint8_t i = 0; i < count; i++, pos++)
+    {
+        pValues[i] = pSlot->values[pos & (ADC_SCAN_BUFFER_SIZE - 1)];
+    }
+    if (bit)
     {
-        ADCSRA |= (1 << ADSC); // retrigger the conversion
+        sei();
+    }
+
+    return count;
+}
+
+uint16_t adc_scanGetCount()
+{
+    uint16_t count;
+
+    uint8_t bit = bit_is_set(SREG, 7);
+    if (bit)
+    {
+        cli();
+    }
+    count = _adc_scanCount;
+    if (bit)
+    {
+        sei();
+    }
+
+    return count;
+}
+
+uint8_t adc_scanIsRunning()
+{
+    return _adc_scanRunning;
+}
+
+// returns the median of the values in the window of a slot
+static uint16_t _adc_scanMedian(struct AdcScanSlot *pSlot)
+{
+    uint16_t sorted[5];
+    uint8_t count = pSlot->medianCount;
+
+    for (uint8_t i = 0; i < count; i++) // insertion sort; at most 10 comparisons
+    {
+        uint16_t value = pSlot->median[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > value)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+
+    return sorted[(count - 1) >> 1];
+}
+
+// stores the result of the scan sequencer and starts the conversion of the next channel
+static inline void _adc_scanConverted()
+{
+    struct AdcScanSlot *pSlot = &_adc_scanSlots[_adc_scanIndex];
+    uint16_t value = (pSlot->admux & (1 << ADLAR)) ? ADCH : ADC;
+
+    if (pSlot->extraBits)
+    {
+        pSlot->sum += value;
+        if (++pSlot->samples < (1 << (2 * pSlot->extraBits)))
+        {
+            ADCSRA |= (1 << ADSC); // 4^n samples of the same channel
+            return;
+        }
+        value = pSlot->sum >> pSlot->extraBits; // decimation
+        pSlot->sum = 0;
+        pSlot->samples = 0;
+    }
+
+    if (pSlot->medianTaps)
+    {
+        pSlot->median[pSlot->medianHead] = value;
+        if (++pSlot->medianHead >= pSlot->medianTaps)
+        {
+            pSlot->medianHead = 0;
+        }
+        if (pSlot->medianCount < pSlot->medianTaps)
+        {
+            pSlot->medianCount++;
+        }
+        value = _adc_scanMedian(pSlot);
+    }
+
+    pSlot->values[pSlot->head] = value;
+    pSlot->head = (pSlot->head + 1) & (ADC_SCAN_BUFFER_SIZE - 1);
+    if (pSlot->count < ADC_SCAN_BUFFER_SIZE)
+    {
+        pSlot->count++;
+    }
+
+    while (++_adc_scanIndex < _adc_scanChannels) // skip the channels, whose scan is not due
+    {
+        pSlot++;
+        if (!pSlot->countdown)
+        {
+            pSlot->countdown = pSlot->divider - 1;
+            _adc_select(pSlot->admux, pSlot->adcsrb);
+            ADCSRA |= (1 << ADSC); // the remaining channels follow immediately
+            return;
+        }
+        pSlot->countdown--;
+    }
+
+    // the scan is complete; the queued requests are served before the next scan
+    _adc_scanCount++;
+    _adc_next();
+
+    if (_adc_scanCallback)
+    {
+        _adc_scanCallback();
+    }
+}
+
+// passes the result to the first request of the queue and starts the next conversion
+static inline void _adc_requestConverted()
+{
+    struct AdcRequest request = _adc_queue[_adc_queueHead];
+    struct AdcClient *pClient = &_adc_clients[request.client];
+    uint16_t value = (request.admux & (1 << ADLAR)) ? ADCH : ADC;
+    uint16_t latency_us = tb_isInitialized() ? (uint16_t)tb_getTime_us() - request.time_us : 0;
+
+    _adc_queueHead = (_adc_queueHead + 1) & (ADC_QUEUE_SIZE - 1);
+    _adc_queueCount--;
+    _adc_next(); // no gap until the next conversion
+
+    if (pClient->requests < 0xFFFF) // stop accumulating, before the mean value gets wrong
+    {
+        if (!pClient->requests || latency_us < pClient->minLatency_us)
+            pClient->minLatency_us = latency_us;
+        if (latency_us > pClient->maxLatency_us)
+            pClient->maxLatency_us = latency_us;
+        pClient->sumLatency_us += latency_us;
+        pClient->requests++;
+    }
+
+    if (request.callback8 ? (*request.callback8)(value) : (*request.callback)(value))
+    {
+        if (request.selected) // the callback may have selected another channel
+        {
+            request.admux = _adc_selectedAdmux | (request.callback8 ? (1 << ADLAR) : 0);
+            request.adcsrb = _adc_selectedAdcsrb;
+        }
+        _adc_submit(&request); // the callback asks for another conversion
+    }
+}
+
+// hands the full capture buffer out and continues with the other one
+static void _adc_captureFull()
+{
+    uint8_t *pFull = _adc_captureEnd - _adc_captureLength;
+    uint8_t *pNext = (pFull == _adc_captureBuffers) ? pFull + _adc_captureLength : _adc_captureBuffers;
+
+    if (_adc_captureReady) // the other buffer has not been released yet; the samples get lost
+    {
+        _adc_captureOverruns++;
+        pNext = pFull;
+        pFull = NULL;
     }
     else
     {
-        ADCSRA &= ~(1 << ADEN); // otherwise, turn of the ADC
+        _adc_captureReady = pFull;
+    }
+    _adc_capturePtr = pNext;
+    _adc_captureEnd = pNext + _adc_captureLength;
+
+    if (pFull && _adc_captureCallback)
+    {
+        _adc_captureCallback(pFull, _adc_captureLength);
+    }
+}
+
+ISR(ADC_vect)
+{
+    if (_adc_state == ADC_STATE_CAPTURE) // checked first, since the capture allows the least time per sample
+    {
+        *_adc_capturePtr++ = ADCH;
+        if (_adc_capturePtr == _adc_captureEnd)
+        {
+            _adc_captureFull();
+        }
+        return;
+    }
+
+    switch (_adc_state)
+    {
+    case ADC_STATE_ARMED: // the trigger source has started the scan
+        ADCSRA &= ~(1 << ADATE); // further trigger events must not start conversions before the channel is switched
+        _adc_state = ADC_STATE_SCAN;
+        // fall through
+    case ADC_STATE_SCAN:
+        _adc_scanConverted();
+        break;
+    case ADC_STATE_REQUEST:
+        _adc_requestConverted();
+        break;
+    case ADC_STATE_SLEEP:
+        _adc_sleepValue = (ADMUX & (1 << ADLAR)) ? ADCH : ADC;
+        _adc_sleepDone = 1;
+        _adc_next();
+        break;
+    case ADC_STATE_AUTO:
+        if (adc_callbackAuto8)
+            (*adc_callbackAuto8)(ADCH);
+        if (adc_callbackAuto10)
+            (*adc_callbackAuto10)(ADC);
+        break;
+    default:
+        break;
     }
 }
@@ -0,0 +1,234 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <err.h>
+#include <mux.h>
+#include <tb.h>
+#include <tlm.h>
+
+#include "daq.h"
+
+#define DAQ_MIN_ADDRESS 0x20 // below are the CPU's registers
+
+struct DaqList
+{
+  uint16_t address[DAQ_MAX_ENTRIES];
+  uint8_t size[DAQ_MAX_ENTRIES];
+  uint8_t entries;
+  uint8_t bytes;     // the sum of the sizes
+  uint8_t event;
+  uint16_t period;   // milliseconds or events
+  uint16_t events;   // the events since the last sample
+  uint8_t counter;   // incremented for every sample
+  TbHandle handle;
+  volatile uint8_t running;
+};
+
+static uint8_t _daq_initialized = 0;
+static struct DaqList _daq_lists[DAQ_MAX_LISTS];
+
+// checks that the range is located in the I/O registers or the SRAM
+static uint8_t _daq_isValid(uint16_t address, uint8_t size)
+{
+  return size && address >= DAQ_MIN_ADDRESS && address <= RAMEND && size - 1 <= RAMEND - address;
+}
+
+static void _daq_sample(uint8_t index)
+{
+  struct DaqList *pList = &_daq_lists[index];
+  uint8_t payload[2 + DAQ_MAX_LIST_SIZE];
+  uint8_t i, j, length = 2;
+  const volatile uint8_t *pSource;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  payload[0] = index;
+  payload[1] = pList->counter++;
+  if (bit)
+    cli();
+  for (i = 0; i < pList->entries; i++)
+  {
+    // ascending, so that 16 bit registers are read low byte first
+    pSource = (const volatile uint8_t *)pList->address[i];
+    for (j = 0; j < pList->size[i]; j++)
+      payload[length++] = pSource[j];
+  }
+  if (bit)
+    sei();
+  tlm_send(TLM_T_DAQ, payload, length);
+}
+
+// called by the timebase for the lists started with DAQ_EV_TIMER
+static uint16_t _daq_timer(void *ctx)
+{
+  struct DaqList *pList = (struct DaqList *)ctx;
+
+  if (!pList->running)
+    return 0;
+  _daq_sample(pList - _daq_lists);
+  return pList->period;
+}
+
+static void _daq_stop(struct DaqList *pList)
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  pList->running = 0;
+  if (pList->handle)
+  {
+    tb_unregister(pList->handle);
+    pList->handle = 0;
+  }
+  if (bit)
+    sei();
+}
+
+static uint8_t _daq_start(struct DaqList *pList, uint8_t event, uint16_t period)
+{
+  if (!period || !pList->entries)
+    return DAQ_S_INVALID;
+  _daq_stop(pList);
+  pList->event = event;
+  pList->period = period;
+  pList->events = 0;
+  if (event == DAQ_EV_TIMER)
+  {
+    pList->handle = tb_registerCtxEx(_daq_timer, pList, period, TB_PERIODIC);
+    if (!pList->handle)
+      return DAQ_S_TB;
+  }
+  pList->running = 1;
+  return DAQ_S_OK;
+}
+
+void daq_init(uint8_t channel)
+{
+  if (_daq_initialized)
+  {
+    err_report(ERR_M_DAQ, ERR_R_ALREADY_INITIALIZED);
+    return;
+  }
+  if (!tb_isInitialized())
+  {
+    err_report(ERR_M_DAQ, ERR_R_TB_MISSING);
+    return;
+  }
+  _daq_initialized = 1;
+  mux_setReceiver(channel, daq_command);
+}
+
+void daq_command(const uint8_t *pData, uint8_t length)
+{
+  uint8_t response[2 + DAQ_MAX_LIST_SIZE];
+  uint8_t responseLength = 2;
+  uint8_t status = DAQ_S_INVALID;
+  struct DaqList *pList = NULL;
+  uint16_t address = 0;
+  uint8_t i, bit;
+
+  if (!length)
+    return;
+  // the most commands address a list in the first parameter, READ and WRITE an address
+  if (length >= 2 && pData[1] < DAQ_MAX_LISTS)
+    pList = &_daq_lists[pData[1]];
+  if (length >= 3)
+    address = pData[1] | ((uint16_t)pData[2] << 8);
+
+  switch (pData[0])
+  {
+  case DAQ_C_CONNECT:
+    response[responseLength++] = DAQ_VERSION;
+    response[responseLength++] = DAQ_MAX_LISTS;
+    response[responseLength++] = DAQ_MAX_ENTRIES;
+    response[responseLength++] = DAQ_MAX_LIST_SIZE;
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_CLEAR:
+    if (!pList)
+      break;
+    status = DAQ_S_RUNNING;
+    if (pList->running)
+      break;
+    pList->entries = 0;
+    pList->bytes = 0;
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_ADD:
+    if (!pList || length < 5 || !_daq_isValid(pData[2] | ((uint16_t)pData[3] << 8), pData[4]))
+      break;
+    status = DAQ_S_RUNNING;
+    if (pList->running)
+      break;
+    status = DAQ_S_FULL;
+    if (pList->entries == DAQ_MAX_ENTRIES || pList->bytes + pData[4] > DAQ_MAX_LIST_SIZE)
+      break;
+    pList->address[pList->entries] = pData[2] | ((uint16_t)pData[3] << 8);
+    pList->size[pList->entries++] = pData[4];
+    pList->bytes += pData[4];
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_START:
+    if (pList && length >= 5)
+      status = _daq_start(pList, pData[2], pData[3] | ((uint16_t)pData[4] << 8));
+    break;
+  case DAQ_C_STOP:
+    if (!pList)
+      break;
+    _daq_stop(pList);
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_READ:
+    if (length < 4 || pData[3] > DAQ_MAX_LIST_SIZE || !_daq_isValid(address, pData[3]))
+      break;
+    bit = bit_is_set(SREG, 7);
+    if (bit)
+      cli();
+    for (i = 0; i < pData[3]; i++)
+      response[responseLength++] = ((const volatile uint8_t *)address)[i];
+    if (bit)
+      sei();
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_WRITE:
+    if (length < 4 || !_daq_isValid(address, length - 3))
+      break;
+    bit = bit_is_set(SREG, 7);
+    if (bit)
+      cli();
+    // descending, so that 16 bit registers are written high byte first
+    for (i = length - 3; i > 0; i--)
+      ((volatile uint8_t *)address)[i - 1] = pData[2 + i];
+    if (bit)
+      sei();
+    status = DAQ_S_OK;
+    break;
+  case DAQ_C_STOP_ALL:
+    for (i = 0; i < DAQ_MAX_LISTS; i++)
+      _daq_stop(&_daq_lists[i]);
+    status = DAQ_S_OK;
+    break;
+  default:
+    status = DAQ_S_UNKNOWN;
+    break;
+  }
+
+  response[0] = pData[0];
+  response[1] = status;
+  tlm_send(TLM_T_DAQ_RESPONSE, response, responseLength);
+}
+
+void daq_event(uint8_t event)
+{
+  uint8_t i;
+
+  for (i = 0; i < DAQ_MAX_LISTS; i++)
+  {
+    if (_daq_lists[i].running && _daq_lists[i].event == event && event != DAQ_EV_TIMER &&
+        ++_daq_lists[i].events >= _daq_lists[i].period)
+    {
+      _daq_lists[i].events = 0;
+      _daq_sample(i);
+    }
+  }
+}
@@ -10,7 +10,7 @@
 #include <dbLed.h>
 #include "dbBtn.h"
 
-#include <uart.h>
+#include <err.h>
 
 static uint8_t _dbBtn_lastState;
 static void (*_dbBtn_redCallback)(uint8_t state) = NULL;
@@ -23,7 +23,7 @@ void dbBtn_init()
 {
     if (!tb_isInitialized())
     {
-        uart0_msg("dbBtn_init: the timebase must be initialized before by tb_init\n");
+        err_report(ERR_M_DBBTN, ERR_R_TB_MISSING);
         return;
     }
 
@@ -95,7 +95,7 @@ void dbBtn_registerRedCallback(void (*callback)(uint8_t state))
 {
     if (!_dbBtn_initialized)
     {
-        uart0_msg("dbBtn_registerRedCallback: dbBtn_init missing\n");
+        err_report(ERR_M_DBBTN, ERR_R_INIT_MISSING);
     }
     _dbBtn_redCallback = callback;
 }
@@ -103,7 +103,7 @@ void dbBtn_registerGreenCallback(void (*callback)(uint8_t state))
 {
     if (!_dbBtn_initialized)
     {
-        uart0_msg("dbBtn_registerGreenCallback: dbBtn_init missing\n");
+        err_report(ERR_M_DBBTN, ERR_R_INIT_MISSING);
     }
     _dbBtn_greenCallback = callback;
 }
@@ -111,7 +111,7 @@ void dbBtn_registerBlueCallback(void (*callback)(uint8_t state))
 {
     if (!_dbBtn_initialized)
     {
-        uart0_msg("dbBtn_registerBlueCallback: dbBtn_init missing\n");
+        err_report(ERR_M_DBBTN, ERR_R_INIT_MISSING);
     }
     _dbBtn_blueCallback = callback;
 }
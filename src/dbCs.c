@@ -2,11 +2,16 @@
 #include <avr/interrupt.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <avr/pgmspace.h>
 #include <string.h>
 
 #include <eeprom.h>
 #include <tb.h>
 #include <uart.h>
+#include <err.h>
+#ifdef DB_CS_TELEMETRY
+#include <tlm.h>
+#endif
 
 #include <dbLs.h>
 #include <dbLed.h>
@@ -66,7 +71,7 @@ void (*_dbCs_registeredCallback)(int8_t colorIndex, const struct DbCsColors *col
 volatile enum DbCsMode _dbCs_mode = DB_CS_CALIBRATE;
 volatile uint16_t _dbCs_overflow = 0;
 volatile uint16_t _dbCs_retriggerTime_ms;
-volatile uint8_t _dbCs_measureHandle = 0;
+volatile TbHandle _dbCs_measureHandle = 0;
 volatile uint8_t _dbCs_minColorIndexesQuality = 5;
 
 volatile struct DbCsColorIndexes _dbCs_colorIndexes;
@@ -172,34 +177,59 @@ void dbCs_init()
     OCR3A = DB_CS_OCR_MAX;  // set measurement period
     // --------------------------------------------------------------------------
 
-    uart0_msg("----------------------------------------\n");
-    uart0_msg("dbCs\n");
-    uart0_msg("----------------------------------------\n");
-    uart0_msg("timing values    : ");
     for (i = 0; i < DB_CS_DATA_SIZE; i++)
     {
         _dbCs_ocrValues[i] = eeprom_read16(DB_CS_EEPROM_ADDRESS + i * 2);
-        sprintf(text, "%d ", _dbCs_ocrValues[i]);
+    }
+    _dbCs_colorNo = eeprom_read(DB_CS_EEPROM_ADDRESS + 12 * 2);
+    for (i = 0; i < _dbCs_colorNo && i < DB_CS_MAX_COLORS; i++)
+    {
+        for (j = 0; j < 12; j++)
+        {
+            _dbCs_colorRefs[i][j] = eeprom_read(DB_CS_EEPROM_ADDRESS + 12 * 2 + 1 + i * 12 + j);
+        }
+    }
+
+#ifdef DB_CS_TELEMETRY
+    tlm_send(TLM_T_CS_CALIB, (const void *)_dbCs_ocrValues, sizeof(_dbCs_ocrValues));
+    for (i = 0; i < _dbCs_colorNo && i < DB_CS_MAX_COLORS; i++)
+    {
+        uint8_t colorRef[13];
+
+        colorRef[0] = i;
+        for (j = 0; j < 12; j++)
+        {
+            colorRef[j + 1] = _dbCs_colorRefs[i][j];
+        }
+        tlm_send(TLM_T_CS_COLOR_REF, colorRef, sizeof(colorRef));
+    }
+#else
+    uart0_msg_P(PSTR("----------------------------------------\n"));
+    uart0_msg_P(PSTR("dbCs\n"));
+    uart0_msg_P(PSTR("----------------------------------------\n"));
+    uart0_msg_P(PSTR("timing values    : "));
+    for (i = 0; i < DB_CS_DATA_SIZE; i++)
+    {
+        sprintf_P(text, PSTR("%d "), _dbCs_ocrValues[i]);
         uart0_msg(text);
     }
-    uart0_msg("\n");
+    uart0_msg_P(PSTR("\n"));
 
-    _dbCs_colorNo = eeprom_read(DB_CS_EEPROM_ADDRESS + 12 * 2);
-    sprintf(text, "colors registered: %d\n", _dbCs_colorNo);
+    sprintf_P(text, PSTR("colors registered: %d\n"), _dbCs_colorNo);
     uart0_msg(text);
     for (i = 0; i < _dbCs_colorNo && i < DB_CS_MAX_COLORS; i++)
     {
-        sprintf(text, "color %d          : ", i);
+        sprintf_P(text, PSTR("color %d          : "), i);
         uart0_msg(text);
         for (j = 0; j < 12; j++)
         {
-            _dbCs_colorRefs[i][j] = eeprom_read(DB_CS_EEPROM_ADDRESS + 12 * 2 + 1 + i * 12 + j);
-            sprintf(text, "%2d ", _dbCs_colorRefs[i][j]);
+            sprintf_P(text, PSTR("%2d "), _dbCs_colorRefs[i][j]);
             uart0_msg(text);
         }
-        uart0_msg("\n");
+        uart0_msg_P(PSTR("\n"));
     }
-    uart0_msg("----------------------------------------\n\n");
+    uart0_msg_P(PSTR("----------------------------------------\n\n"));
+#endif
 
     if (dbBtn_isPressed(DB_BTN_BLUE))
     {
@@ -435,7 +465,7 @@ void dbCs_getColorIndexes(void (*readyCallback)(const struct DbCsColors *colors,
 {
     if (!_dbCs_initialized)
     {
-        uart0_msg("dbCs_getColorIndexes: dbCs_init missing\n");
+        err_report(ERR_M_DBCS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -449,7 +479,7 @@ uint8_t dbCs_registerColor(void (*readyCallback)(int8_t colorIndex, const struct
 {
     if (!_dbCs_initialized)
     {
-        uart0_msg("dbCs_registerColor: dbCs_init missing\n");
+        err_report(ERR_M_DBCS, ERR_R_INIT_MISSING);
         return 0;
     }
 
@@ -471,7 +501,7 @@ void dbCs_startContinuousMeasurements(uint16_t time_ms, void (*changedCallback)(
 {
     if (!_dbCs_initialized)
     {
-        uart0_msg("dbCs_startContinuousMeasurements: dbCs_init missing\n");
+        err_report(ERR_M_DBCS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -488,10 +518,10 @@ void dbCs_startContinuousMeasurements(uint16_t time_ms, void (*changedCallback)(
     }
 
     _dbCs_lastColorIndexes.left = -1; // to trigger at least one changed callback
-    _dbCs_measureHandle = tb_register(_dbCs_continuousMeasurements, time_ms);
+    _dbCs_measureHandle = tb_registerEx(_dbCs_continuousMeasurements, time_ms, TB_PERIODIC);
     if (!_dbCs_measureHandle)
     {
-        uart0_msg("dbCs_startContinuousMeasurements: could not register tb-callback\n");
+        err_report(ERR_M_DBCS, ERR_R_TB_REGISTER);
         return;
     }
 }
@@ -500,7 +530,7 @@ void dbCs_stopContinuousMeasurements()
 {
     if (!_dbCs_initialized)
     {
-        uart0_msg("dbCs_stopContinuousMeasurements: dbCs_init missing\n");
+        err_report(ERR_M_DBCS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -7,11 +7,11 @@
 #include <util/delay.h>
 
 #include <tb.h>
-#include <uart.h>
+#include <err.h>
 
 #include "dbIrc.h"
 
-uint8_t _dbIrc_timeout;
+TbHandle _dbIrc_timeout;
 uint8_t _dbIrc_cnt = 0;
 uint32_t _dbIrc_value = 0;
 uint8_t _dbIrc_initialized = 0;
@@ -21,7 +21,7 @@ void dbIrc_registerReceptionCallback(void(*callback)(uint32_t code))
 {
   if (!_dbIrc_initialized)
   {
-    uart0_msg("dbIrc_registerReceptionCallback: dbIrc_init missing\n");
+    err_report(ERR_M_DBIRC, ERR_R_INIT_MISSING);
   }
   _dbIrc_callback = callback;
 }
@@ -34,19 +34,18 @@ uint16_t _dbIrc_reset()
   return 200;
 }
 
+#define DB_IRC_ONE_MAX_US   1600    // a shorter time between two falling edges is a 1
+
 ISR(INT2_vect)
 {
-  static uint16_t lastValue = 0;
+  static uint32_t lastTime_us = 0;
   uint8_t value;
 
-  int16_t diff = TCNT1 - lastValue;
-  lastValue = TCNT1;
+  uint32_t time_us = tb_getTime_us();
+  uint32_t diff_us = time_us - lastTime_us;
+  lastTime_us = time_us;
 
-  if (diff < 0)
-  {
-    diff += OCR1A;      // an overflow happened
-  }
-  if (diff >= 0 && diff <= 100)
+  if (diff_us <= DB_IRC_ONE_MAX_US)
   {
     value = 1;
   }
@@ -110,7 +109,7 @@ void dbIrc_init()
   _dbIrc_timeout = tb_register(_dbIrc_reset, 200);
   if (!_dbIrc_timeout)
   {
-    uart0_msg("dbIrc_init: could not register tb-callback\n");
+    err_report(ERR_M_DBIRC, ERR_R_TB_REGISTER);
   }
   tb_stopTimeout(_dbIrc_timeout);
 
@@ -145,7 +144,7 @@ void dbIrc_send(uint32_t code)
 {
   if (!_dbIrc_initialized)
   {
-    uart0_msg("dbIrc_registerReceptionCallback: dbIrc_init missing\n");
+    err_report(ERR_M_DBIRC, ERR_R_INIT_MISSING);
     return;
   }
 
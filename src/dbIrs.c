@@ -4,22 +4,22 @@
 
 #include <tb.h>
 #include <adc.h>
-#include <uart.h>
+#include <err.h>
 
 #include "dbIrs.h"
 
 static struct DbDistances _dbIrs_distances;
-static volatile uint8_t _dbIrs_sensorIndex;
 static volatile uint8_t _dbIrs_sensors;
-static volatile uint8_t _dbIrs_handle = 0;
-static uint8_t _dbIrs_valuesChanged = 0;
+static uint8_t _dbIrs_scanIndex[4]; // the index of each sensor's channel in the scan sequencer
+static volatile TbHandle _dbIrs_handle = 0;
+static volatile uint8_t _dbIrs_singleShot = 0; // 1, while a single measurement is running
 static uint16_t _dbIrs_retriggerTime_ms = 0;
 
 static void (*_dbIrs_readyCallback)(const struct DbDistances *pDistances);
 static void (*_dbIrs_changedCallback)(const struct DbDistances *pDistances);
 
 static uint8_t _dbIrs_convert(uint16_t value);
-static uint8_t _dbIrs_measured(uint16_t value);
+static void _dbIrs_scanned();
 static uint16_t _dbIrs_continuousMeasurement();
 
 static uint8_t _dbIrs_initialized = 0;
@@ -97,57 +97,99 @@ void dbIrs_stopContinuousMeasurements()
     {
         tb_unregister(_dbIrs_handle);
         _dbIrs_handle = 0;
+        adc_scanStop();
     }
 }
 
-uint8_t _dbIrs_measured(uint16_t value)
+// aborts a single measurement, which is still running
+static void _dbIrs_stopSingleMeasurement()
 {
-    uint16_t newValue = _dbIrs_convert(value);
-    uint8_t *pActDistance = NULL;
+    if (_dbIrs_singleShot)
+    {
+        _dbIrs_singleShot = 0;
+        adc_scanStop();
+    }
+}
 
-    switch (_dbIrs_sensorIndex)
+// returns the distance measured by the sensor with the given index
+static uint8_t *_dbIrs_distance(uint8_t sensorIndex)
+{
+    switch (sensorIndex)
     {
     case 0:
-        pActDistance = &(_dbIrs_distances.left_cm);
-        break;
+        return &(_dbIrs_distances.left_cm);
     case 1:
-        pActDistance = &(_dbIrs_distances.back_cm);
-        break;
+        return &(_dbIrs_distances.back_cm);
     case 2:
-        pActDistance = &(_dbIrs_distances.right_cm);
-        break;
-    case 3:
-        pActDistance = &(_dbIrs_distances.front_cm);
-        break;
+        return &(_dbIrs_distances.right_cm);
+    default:
+        return &(_dbIrs_distances.front_cm);
     }
+}
 
-    if ((pActDistance != NULL) && (newValue != *pActDistance))
-    {
-        _dbIrs_valuesChanged = 1;
-        *pActDistance = newValue;
-    }
+// called by the ADC interrupt once all selected sensors have been converted
+void _dbIrs_scanned()
+{
+    uint8_t valuesChanged = 0;
+    uint16_t vcc_mV = adc_getVcc_mV(); // 0, unless the monitor of the ADC library runs
 
-    _dbIrs_sensorIndex++;
-    while (_dbIrs_sensorIndex < 4 && !(_dbIrs_sensors & (1 << _dbIrs_sensorIndex)))
+    for (uint8_t i = 0; i < 4; i++)
     {
-        _dbIrs_sensorIndex++;
+        if (_dbIrs_sensors & (1 << i))
+        {
+            uint16_t value = (adc_scanGet(_dbIrs_scanIndex[i]) + ((1 << DB_IRS_OVERSAMPLING) >> 1)) >> DB_IRS_OVERSAMPLING;
+            if (vcc_mV)
+            {
+                value = (uint32_t)value * vcc_mV / DB_IRS_VCC_MV; // the sensors' output does not scale with AVCC
+            }
+            uint8_t newValue = _dbIrs_convert(value);
+            uint8_t *pActDistance = _dbIrs_distance(i);
+
+            if (newValue != *pActDistance)
+            {
+                valuesChanged = 1;
+                *pActDistance = newValue;
+            }
+        }
     }
 
-    if (_dbIrs_sensorIndex < 4)
+    if (_dbIrs_singleShot) // the sequencer is released, before the callback may start the next measurement
     {
-        adc_selectChannel(ADC_AVCC, _dbIrs_sensorIndex);
-        return 1;
+        _dbIrs_singleShot = 0;
+        adc_scanStop();
     }
-
     if (_dbIrs_readyCallback)
     {
         _dbIrs_readyCallback(&_dbIrs_distances);
     }
-    if (_dbIrs_valuesChanged && _dbIrs_changedCallback)
+    if (valuesChanged && _dbIrs_changedCallback)
     {
         (*_dbIrs_changedCallback)(&_dbIrs_distances);
     }
-    return 0;
+}
+
+// puts the channels of the selected sensors into the list of the scan sequencer and starts it;
+// a sequencer started by another module is left alone
+static uint8_t _dbIrs_startScan(uint8_t sensors)
+{
+    if (adc_scanIsRunning())
+    {
+        err_report(ERR_M_DBIRS, ERR_R_FAILED);
+        return 0;
+    }
+
+    _dbIrs_sensors = (sensors >> 4);
+
+    adc_scanClear();
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (_dbIrs_sensors & (1 << i))
+        {
+            _dbIrs_scanIndex[i] = adc_scanAdd(ADC_AVCC, i, ADC_RES_10);
+            adc_scanSetFilter(_dbIrs_scanIndex[i], DB_IRS_OVERSAMPLING, DB_IRS_MEDIAN);
+        }
+    }
+    return adc_scanStart(ADC_TS_SOFTWARE, _dbIrs_scanned);
 }
 
 // stops continuous measurements
@@ -155,42 +197,30 @@ void dbIrs_triggerSingleMeasurement(uint8_t sensors, void (*readyCallback)())
 {
     if (!_dbIrs_initialized)
     {
-        uart0_msg("dbIrs_triggerSingleMeasurement: dbIrs_init missing\n");
+        err_report(ERR_M_DBIRS, ERR_R_INIT_MISSING);
         return;
     }
 
     dbIrs_stopContinuousMeasurements();
 
-    _dbIrs_readyCallback = readyCallback;
-    _dbIrs_sensors = (sensors >> 4);
-
-    _dbIrs_sensorIndex = 0;
-    while (_dbIrs_sensorIndex < 4 && !(_dbIrs_sensors & (1 << _dbIrs_sensorIndex)))
+    if (!(sensors & (DB_IRS_SENSOR_FRONT | DB_IRS_SENSOR_BACK | DB_IRS_SENSOR_LEFT | DB_IRS_SENSOR_RIGHT)))
     {
-        _dbIrs_sensorIndex++;
+        return;
     }
 
-    if (_dbIrs_sensorIndex < 4)
+    _dbIrs_stopSingleMeasurement();
+    _dbIrs_readyCallback = readyCallback;
+    if (!_dbIrs_startScan(sensors))
     {
-        adc_selectChannel(ADC_AVCC, _dbIrs_sensorIndex);
-        adc_trigger10(_dbIrs_measured);
+        return;
     }
+    _dbIrs_singleShot = 1;
+    adc_scanTrigger();
 };
 
 uint16_t _dbIrs_continuousMeasurement()
 {
-    _dbIrs_sensorIndex = 0;
-    while (_dbIrs_sensorIndex < 4 && !(_dbIrs_sensors & (1 << _dbIrs_sensorIndex)))
-    {
-        _dbIrs_sensorIndex++;
-    }
-
-    if (_dbIrs_sensorIndex < 4)
-    {
-        _dbIrs_valuesChanged = 0;
-        adc_selectChannel(ADC_AVCC, _dbIrs_sensorIndex);
-        adc_trigger10(_dbIrs_measured);
-    }
+    adc_scanTrigger(); // skipped, if the previous scan is still running
 
     return _dbIrs_retriggerTime_ms;
 }
@@ -200,26 +230,32 @@ void dbIrs_startContinuousMeasurements(uint8_t sensors, uint16_t time_ms, void (
 {
     if (!_dbIrs_initialized)
     {
-        uart0_msg("dbIrs_startContinuousMeasurements: dbIrs_init missing\n");
+        err_report(ERR_M_DBIRS, ERR_R_INIT_MISSING);
         return;
     }
 
     if (!(sensors & (DB_IRS_SENSOR_FRONT | DB_IRS_SENSOR_BACK | DB_IRS_SENSOR_LEFT | DB_IRS_SENSOR_RIGHT))) // if none of the infrared sensors is selected
     {
-        uart0_msg("dbIrs_startContinuousMeasurements: no sensor selected\n");
+        err_report(ERR_M_DBIRS, ERR_R_NO_SENSOR);
         return;
     }
 
-    _dbIrs_sensors = (sensors >> 4);
+    dbIrs_stopContinuousMeasurements();
+
+    _dbIrs_stopSingleMeasurement();
     _dbIrs_readyCallback = NULL;
     _dbIrs_changedCallback = changedCallback;
     _dbIrs_retriggerTime_ms = time_ms;
 
-    dbIrs_stopContinuousMeasurements();
-    _dbIrs_handle = tb_register(_dbIrs_continuousMeasurement, time_ms);
+    if (!_dbIrs_startScan(sensors))
+    {
+        return;
+    }
+    _dbIrs_handle = tb_registerEx(_dbIrs_continuousMeasurement, time_ms, TB_PERIODIC);
     if (!_dbIrs_handle)
     {
-        uart0_msg("dbIrs_startContinuousMeasurements: could not register tb-callback\n");
+        adc_scanStop();
+        err_report(ERR_M_DBIRS, ERR_R_TB_REGISTER);
         return;
     }
 };
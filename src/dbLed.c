@@ -6,7 +6,7 @@
 #include <util/delay.h>
 
 #include <ws2812.h>
-#include <uart.h>
+#include <err.h>
 
 #include "dbLed.h"
 
@@ -42,7 +42,7 @@ void dbLed_prepareColor(enum DB_LED_ID ledId, uint8_t r, uint8_t g, uint8_t b)
 {
     if (!_dbLed_initialized)
     {
-        uart0_msg("dbLed_prepareColor: dbLed_init missing\n");
+        err_report(ERR_M_DBLED, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -56,7 +56,7 @@ void dbLed_refresh()
 {
     if (!_dbLed_initialized)
     {
-        uart0_msg("dbLed_refresh: dbLed_init missing\n");
+        err_report(ERR_M_DBLED, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -68,7 +68,7 @@ void dbLed_setColor(enum DB_LED_ID ledId, uint8_t r, uint8_t g, uint8_t b)
 {
     if (!_dbLed_initialized)
     {
-        uart0_msg("dbLed_setColor: dbLed_init missing\n");
+        err_report(ERR_M_DBLED, ERR_R_INIT_MISSING);
         return;
     }
 
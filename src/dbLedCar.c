@@ -2,17 +2,23 @@
 
 #include <ws2812.h>
 #include <tb.h>
-#include <uart.h>
+#include <err.h>
 
 #include <dbLed.h>
 //#include <dbLs.h>
 #include "dbLedCar.h"
 
+#ifdef DB_LED_CAR_DEFERRED
+#define DB_LED_CAR_TB_OPTIONS TB_DEFERRED // the LEDs are refreshed by tb_poll
+#else
+#define DB_LED_CAR_TB_OPTIONS 0
+#endif
+
 static uint8_t _dbLedCar_state = 0;
 static uint8_t _dbLedCar_indicator = DB_LED_CAR_INDICATOR_OFF;
 static uint8_t _dbLedCar_indicatorLight = 0;
 
-static uint8_t _dbLedCar_indicatorHandle = 0;
+static TbHandle _dbLedCar_indicatorHandle = 0;
 
 static uint8_t _dbLedCar_initialized = 0;
 
@@ -117,7 +123,7 @@ void dbLedCar_light(uint8_t on)
 {
     if (!_dbLedCar_initialized)
     {
-        uart0_msg("dbLedCar_light: dbLedCar_init missing\n");
+        err_report(ERR_M_DBLEDCAR, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -137,7 +143,7 @@ void dbLedCar_headlight(uint8_t on)
 {
     if (!_dbLedCar_initialized)
     {
-        uart0_msg("dbLedCar_headlight: dbLedCar_init missing\n");
+        err_report(ERR_M_DBLEDCAR, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -157,7 +163,7 @@ void dbLedCar_brakelight(uint8_t on)
 {
     if (!_dbLedCar_initialized)
     {
-        uart0_msg("dbLedCar_brakelight: dbLedCar_init missing\n");
+        err_report(ERR_M_DBLEDCAR, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -176,7 +182,7 @@ void dbLedCar_backlight(uint8_t on)
 {
     if (!_dbLedCar_initialized)
     {
-        uart0_msg("dbLedCar_backlight: dbLedCar_init missing\n");
+        err_report(ERR_M_DBLEDCAR, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -195,7 +201,7 @@ void dbLedCar_indicator(enum DbLedCarIndicator indicator)
 {
     if (!_dbLedCar_initialized)
     {
-        uart0_msg("dbLedCar_indicator: dbLedCar_init missing\n");
+        err_report(ERR_M_DBLEDCAR, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -209,10 +215,10 @@ void dbLedCar_indicator(enum DbLedCarIndicator indicator)
     _dbLedCar_indicatorLight = 0;
     if (_dbLedCar_indicator != DB_LED_CAR_INDICATOR_OFF)
     {
-        _dbLedCar_indicatorHandle = tb_register(_dbLedCar_indicatorBlink, 400);
+        _dbLedCar_indicatorHandle = tb_registerEx(_dbLedCar_indicatorBlink, 400, DB_LED_CAR_TB_OPTIONS);
         if (!_dbLedCar_indicatorHandle)
         {
-            uart0_msg("dbLedCar_indicator: could not register tb-callback\n");
+            err_report(ERR_M_DBLEDCAR, ERR_R_TB_REGISTER);
             return;
         }
     }
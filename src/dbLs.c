@@ -3,7 +3,7 @@
 #include <stdlib.h>
 
 #include <tb.h>
-#include <uart.h>
+#include <err.h>
 
 #define LOUDSPEAKER (1 << 6) // the loudspeaker is connected to pinH.6
 
@@ -20,7 +20,7 @@ struct DbLsPlay
     struct DbLsNote *pNotes;
     uint16_t actNote;
     uint8_t (*readyCallback)();
-    uint8_t callbackHandle;
+    TbHandle callbackHandle;
     uint8_t toneLength;
     uint8_t actToneLength;
 };
@@ -87,7 +87,7 @@ void dbLs_buzzerOn(enum DbLsPitch pitch)
 {
     if (!_dbLs_initialized)
     {
-        uart0_msg("dbLs_buzzerOn: dbLs_init missing\n");
+        err_report(ERR_M_DBLS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -103,7 +103,7 @@ void dbLs_buzzerOff()
 {
     if (!_dbLs_initialized)
     {
-        uart0_msg("dbLs_buzzerOff: dbLs_init missing\n");
+        err_report(ERR_M_DBLS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -155,7 +155,7 @@ void dbLs_playSong(struct DbLsNote *pNotes, enum DbLsPlayMode playMode, uint8_t
 {
     if (!_dbLs_initialized)
     {
-        uart0_msg("dbLs_playSong: dbLs_init missing\n");
+        err_report(ERR_M_DBLS, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -171,10 +171,10 @@ void dbLs_playSong(struct DbLsNote *pNotes, enum DbLsPlayMode playMode, uint8_t
         _dbLs_setPitch(dbLsPlay.pNotes[dbLsPlay.actNote].pitch);
         dbLsPlay.toneLength = dbLsPlay.pNotes[dbLsPlay.actNote].length;
         dbLsPlay.actToneLength = 0;
-        dbLsPlay.callbackHandle = tb_register(_dbLs_playCallback, 50);
+        dbLsPlay.callbackHandle = tb_registerEx(_dbLs_playCallback, 50, TB_LOW_PRIORITY);
         if (!dbLsPlay.callbackHandle)
         {
-            uart0_msg("dbLs_playSong: could not register tb-callback\n");
+            err_report(ERR_M_DBLS, ERR_R_TB_REGISTER);
             return;
         }
     }
@@ -184,7 +184,7 @@ void dbLs_stopSong()
 {
     if (!_dbLs_initialized)
     {
-        uart0_msg("dbLs_stopSong: dbLs_init missing\n");
+        err_report(ERR_M_DBLS, ERR_R_INIT_MISSING);
         return;
     }
 
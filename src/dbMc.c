@@ -5,7 +5,14 @@
 #include <tb.h>
 #include <uart.h>
 #include <eeprom.h>
+#include <log.h>
 #include "dbMc.h"
+#ifdef DB_MC_TELEMETRY
+#include <tlm.h>
+#endif
+#ifdef DB_MC_DAQ
+#include <daq.h>
+#endif
 
 // Pins to control the DiscBot's H-bridge
 #define MOTOR_LEFT_ENA   (1 << 3)       // PinL.3
@@ -63,7 +70,7 @@ static volatile uint32_t _dbMc_maxTicksRight = 0;
 static void (*_dbMc_brakeLeftCallback)() = NULL;        // pointer to the function to be called when the left wheel stopped turning
 static void (*_dbMc_brakeRightCallback)() = NULL;       // pointer to the function to be called when the right wheel stopped turning
 static void (*_dbMc_brakeCallback)() = NULL;            // pointer to the function to be called when both wheels stopped turning
-static volatile uint8_t _dbMc_brakePhase;               // counter of the wheels that stopped turning
+static volatile uint8_t _dbMc_brakePhase = 2;           // counter of the wheels that stopped turning; 2 if no maneuver is running
 static volatile uint8_t _dbMc_brakeStepLeft=0;          // counts how long the left wheel is already braking
 static volatile uint8_t _dbMc_brakeStepRight=0;         // counts how long the right wheel is already braking
 
@@ -105,7 +112,7 @@ void dbMc_init()
   EICRB &= ~((1 << ISC40) | (1 << ISC50));
   EIMSK |= ((1 << INT4) | (1 << INT5));
 
-  tb_register(&dbMc_calcAndUpdateSpeed, SPEED_UPDATE_RATE_MS); // the speed shall be calculated and updated regularly
+  tb_registerEx(&dbMc_calcAndUpdateSpeed, SPEED_UPDATE_RATE_MS, TB_PERIODIC); // the speed shall be calculated and updated regularly
 
   sei();
 }
@@ -317,6 +324,10 @@ void dbMc_brake(void (*doneCallback)())
 // ----------------------------------------------------------------------------
 // maneuvers
 // ----------------------------------------------------------------------------
+uint8_t dbMc_isBusy()
+{
+  return _dbMc_brakePhase < 2;
+}
 void dbMc_move(uint16_t distance_mm, int16_t speed_cmps, void (*doneCallback)())
 {
   dbMc_setSpeedAndDirection(speed_cmps, 0);
@@ -462,10 +473,22 @@ uint16_t dbMc_calcAndUpdateSpeed()
     }
   }
 
-// static uint8_t temp[64];
-//  sprintf(temp, "{%x-%x}", _dbMc_brakeLeftCallback, _dbMc_brakeRightCallback);
-//  sprintf(temp, "left: %4d->%4d, right: %4d->%4d\n", _dbMc_speedLeft_cmps, speedLeft_cms, _dbMc_speedRight_cmps, speedRight_cms);
-//  uart0_msg(temp);
+#ifdef DB_MC_TELEMETRY
+  {
+    uint16_t record[6];
+
+    record[0] = _dbMc_targetTicksLeft;
+    record[1] = _dbMc_targetTicksRight;
+    record[2] = _dbMc_targetTicksLeft - diffCntLeft;    // the ticks counted in this cycle
+    record[3] = _dbMc_targetTicksRight - diffCntRight;
+    record[4] = OCR_LEFT;
+    record[5] = OCR_RIGHT;
+    tlm_send(TLM_T_MC, record, sizeof(record));
+  }
+#endif
+#ifdef DB_MC_DAQ
+  daq_event(DAQ_EV_DBMC);
+#endif
 
 
   return SPEED_UPDATE_RATE_MS;                          // recall this function regularly
@@ -481,6 +504,7 @@ ISR(INT5_vect)                                          // left encoder
     _dbMc_maxTicksLeft--;
     if (!_dbMc_maxTicksLeft)
     {
+      LOG1(DBMC_TARGET_LEFT, OCR_LEFT);
       dbMc_brakeLeft(_dbMc_brakeLeftCallback);          // if yes, then brake the left wheel
     }
   }
@@ -512,6 +536,7 @@ ISR(INT4_vect)                                          // right encoder
     _dbMc_maxTicksRight--;
     if (!_dbMc_maxTicksRight)
     {
+      LOG1(DBMC_TARGET_RIGHT, OCR_RIGHT);
       dbMc_brakeRight(_dbMc_brakeRightCallback);
     }
   }
@@ -3,7 +3,7 @@
 #include <stdlib.h>
 
 #include <tb.h>
-#include <uart.h>
+#include <err.h>
 
 #include <dbUss.h>
 #include <dbIrs.h>
@@ -100,7 +100,7 @@ void dbRf_triggerSingleMeasurement(uint8_t sensors, void (*readyCallback)(const
 {
     if (!_dbRf_initialized)
     {
-        uart0_msg("dbRf_triggerSingleMeasurement: dbRf_init missing\n");
+        err_report(ERR_M_DBRF, ERR_R_INIT_MISSING);
         return;
     }
     _dbRf_distances.front_cm = _dbRf_distances.back_cm = _dbRf_distances.left_cm = _dbRf_distances.right_cm = 255;
@@ -126,7 +126,7 @@ void dbRf_startContinuousMeasurements(uint8_t sensors, uint16_t time_ms, void (*
 {
     if (!_dbRf_initialized)
     {
-        uart0_msg("dbRf_startContinuousMeasurements: dbRf_init missing\n");
+        err_report(ERR_M_DBRF, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -149,7 +149,7 @@ void dbRf_stopContinuousMeasurements()
 {
     if (!_dbRf_initialized)
     {
-        uart0_msg("dbRf_stopContinuousMeasurements: dbRf_init missing\n");
+        err_report(ERR_M_DBRF, ERR_R_INIT_MISSING);
         return;
     }
 
@@ -3,14 +3,20 @@
 
 #include <mfrc522.h>
 #include <tb.h>
-#include <uart.h>
+#include <err.h>
 #include <eeprom.h>
 
 #include "dbRfid.h"
 
 #define DB_RFID_MAX_CARD_NO    8
 
-static volatile uint8_t _dbRfid_handle = 0;
+#ifdef DB_RFID_DEFERRED
+#define DB_RFID_TB_OPTIONS TB_DEFERRED // the SPI transfers of the detection run in tb_poll
+#else
+#define DB_RFID_TB_OPTIONS 0
+#endif
+
+static volatile TbHandle _dbRfid_handle = 0;
 static void (*_dbRfid_cardDetectedCallback)(uint32_t uid);
 static uint16_t _dbRfid_continuousDetection();
 static uint16_t _dbRfid_intervalTime_ms;
@@ -58,7 +64,7 @@ void dbRfid_stopContinuousDetection()
 {
   if (!_dbRfid_initialized)
   {
-    uart0_msg("dbRfid_stopContinuousDetection: dbRfid_init missing\n");
+    err_report(ERR_M_DBRFID, ERR_R_INIT_MISSING);
     return;
   }
 
@@ -74,7 +80,7 @@ uint8_t dbRfid_getUid(uint32_t* uid)
 {
   if (!_dbRfid_initialized)
   {
-    uart0_msg("dbRfid_getUid: dbRfid_init missing\n");
+    err_report(ERR_M_DBRFID, ERR_R_INIT_MISSING);
     return 0;
   }
 
@@ -94,7 +100,7 @@ void dbRfid_unregisterCards()
 {
   if (!_dbRfid_initialized)
   {
-    uart0_msg("dbRfid_unregisterCards: dbRfid_init missing\n");
+    err_report(ERR_M_DBRFID, ERR_R_INIT_MISSING);
     return;
   }
 
@@ -106,7 +112,7 @@ int8_t dbRfid_registerCard(uint32_t uid)
 {
   if (!_dbRfid_initialized)
   {
-    uart0_msg("dbRfid_registerCard: dbRfid_init missing\n");
+    err_report(ERR_M_DBRFID, ERR_R_INIT_MISSING);
     return -1;
   }
 
@@ -174,7 +180,7 @@ void dbRfid_startContinuousDetection(uint16_t time_ms, void (*cardDetectedCallba
 {
   if (!_dbRfid_initialized)
   {
-    uart0_msg("dbRfid_startContinuousDetection: dbRfid_init missing\n");
+    err_report(ERR_M_DBRFID, ERR_R_INIT_MISSING);
     return;
   }
 
@@ -182,10 +188,10 @@ void dbRfid_startContinuousDetection(uint16_t time_ms, void (*cardDetectedCallba
   _dbRfid_intervalTime_ms = time_ms;
 
   dbRfid_stopContinuousDetection();
-  _dbRfid_handle = tb_register(_dbRfid_continuousDetection, _dbRfid_intervalTime_ms);
+  _dbRfid_handle = tb_registerEx(_dbRfid_continuousDetection, _dbRfid_intervalTime_ms, DB_RFID_TB_OPTIONS);
   if (!_dbRfid_handle)
   {
-    uart0_msg("dbRfid_startContinuousDetection: could not register tb-callback\n");
+    err_report(ERR_M_DBRFID, ERR_R_TB_REGISTER);
   }
 };
 
@@ -3,13 +3,13 @@
 
 #include <tb.h>
 #include <sr04.h>
-#include <uart.h>
+#include <err.h>
 
 #include "dbUss.h"
 
 static struct DbDistances   _dbUss_distances;
 static volatile uint8_t     _dbUss_sensors;
-static volatile uint8_t     _dbUss_handle = 0;
+static volatile TbHandle     _dbUss_handle = 0;
 static uint8_t              _dbUss_initialized = 0;
 
 static void (*_dbUss_readyCallback)(const struct DbDistances* pDistances);
@@ -42,7 +42,7 @@ void dbUss_stopContinuousMeasurements()
 {
   if (!_dbUss_initialized)
   {
-    uart0_msg("dbUss_stopContinuousMeasurements: dbUss_init missing\n");
+    err_report(ERR_M_DBUSS, ERR_R_INIT_MISSING);
     return;
   }
 
@@ -100,7 +100,7 @@ void dbUss_triggerSingleMeasurement(uint8_t sensors, void (*readyCallback)(const
 {
   if (!_dbUss_initialized)
   {
-    uart0_msg("dbUss_triggerSingleMeasurement: dbUss_init missing\n");
+    err_report(ERR_M_DBUSS, ERR_R_INIT_MISSING);
     return;
   }
 
@@ -126,13 +126,13 @@ void dbUss_startContinuousMeasurements(uint8_t sensors, uint16_t time_ms, void (
 {
   if (!_dbUss_initialized)
   {
-    uart0_msg("dbUss_startContinuousMeasurements: dbUss_init missing\n");
+    err_report(ERR_M_DBUSS, ERR_R_INIT_MISSING);
     return;
   }
 
   if (!(sensors & (DB_USS_SENSOR_FRONT | DB_USS_SENSOR_BACK | DB_USS_SENSOR_LEFT | DB_USS_SENSOR_RIGHT)))      // if none of the ultrasonic sensors is selected
   {
-    uart0_msg("dbUss_startContinuousMeasurements: no sensor selected\n");
+    err_report(ERR_M_DBUSS, ERR_R_NO_SENSOR);
     return;
   }
 
@@ -142,10 +142,10 @@ void dbUss_startContinuousMeasurements(uint8_t sensors, uint16_t time_ms, void (
   _dbUss_retriggerTime_ms = time_ms;
 
   dbUss_stopContinuousMeasurements();
-  _dbUss_handle = tb_register(_dbUss_continuousMeasurement, time_ms);
+  _dbUss_handle = tb_registerEx(_dbUss_continuousMeasurement, time_ms, TB_PERIODIC);
   if (!_dbUss_handle)
   {
-    uart0_msg("dbUss_startContinuousMeasurements: could not register tb-callback\n");
+    err_report(ERR_M_DBUSS, ERR_R_TB_REGISTER);
     return;
   }
 };
@@ -0,0 +1,113 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+
+#include "err.h"
+#include <uart.h>
+
+static volatile uint16_t _err_last = 0;
+static volatile uint16_t _err_count = 0;
+
+#ifdef ERR_VERBOSE
+// the names are stored in the flash memory; the tables are indexed by the enum values
+static const char _err_mAdc[] PROGMEM = "adc";
+static const char _err_mDbBtn[] PROGMEM = "dbBtn";
+static const char _err_mDbCs[] PROGMEM = "dbCs";
+static const char _err_mDbIrc[] PROGMEM = "dbIrc";
+static const char _err_mDbIrs[] PROGMEM = "dbIrs";
+static const char _err_mDbLed[] PROGMEM = "dbLed";
+static const char _err_mDbLedCar[] PROGMEM = "dbLedCar";
+static const char _err_mDbLs[] PROGMEM = "dbLs";
+static const char _err_mDbMc[] PROGMEM = "dbMc";
+static const char _err_mDbRf[] PROGMEM = "dbRf";
+static const char _err_mDbRfid[] PROGMEM = "dbRfid";
+static const char _err_mDbUss[] PROGMEM = "dbUss";
+static const char _err_mSpi[] PROGMEM = "spi";
+static const char _err_mTb[] PROGMEM = "tb";
+static const char _err_mTbTask[] PROGMEM = "tbTask";
+static const char _err_mLog[] PROGMEM = "log";
+static const char _err_mMux[] PROGMEM = "mux";
+static const char _err_mDaq[] PROGMEM = "daq";
+static PGM_P const _err_modules[] PROGMEM = {
+    NULL, _err_mAdc, _err_mDbBtn, _err_mDbCs, _err_mDbIrc, _err_mDbIrs, _err_mDbLed, _err_mDbLedCar,
+    _err_mDbLs, _err_mDbMc, _err_mDbRf, _err_mDbRfid, _err_mDbUss, _err_mSpi, _err_mTb, _err_mTbTask, _err_mLog, _err_mMux, _err_mDaq};
+
+static const char _err_rInitMissing[] PROGMEM = "init missing";
+static const char _err_rAlreadyInitialized[] PROGMEM = "already initialized";
+static const char _err_rTbMissing[] PROGMEM = "tb_init missing";
+static const char _err_rTbRegister[] PROGMEM = "could not register tb-callback";
+static const char _err_rNoSensor[] PROGMEM = "no sensor selected";
+static const char _err_rNoMemory[] PROGMEM = "too less memory";
+static const char _err_rInvalidArg[] PROGMEM = "invalid argument";
+static const char _err_rInvalidHandle[] PROGMEM = "invalid handle";
+static const char _err_rNoSlot[] PROGMEM = "no free slot";
+static const char _err_rInterruptsDisabled[] PROGMEM = "interrupts disabled";
+static const char _err_rFailed[] PROGMEM = "failed";
+static PGM_P const _err_reasons[] PROGMEM = {
+    NULL, _err_rInitMissing, _err_rAlreadyInitialized, _err_rTbMissing, _err_rTbRegister, _err_rNoSensor,
+    _err_rNoMemory, _err_rInvalidArg, _err_rInvalidHandle, _err_rNoSlot, _err_rInterruptsDisabled, _err_rFailed};
+#endif
+
+// sends the lower 4 bits of the value as hex digit
+static void _err_putHex(uint8_t value)
+{
+  value &= 0x0F;
+  uart0_putc(value < 10 ? '0' + value : 'A' + value - 10);
+}
+
+void err_report(enum ErrModule module, enum ErrReason reason)
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  _err_last = ERR_CODE(module, reason);
+  if (_err_count < 0xFFFF)
+    _err_count++;
+  if (bit)
+    sei();
+
+  uart0_msg_P(PSTR("E"));
+  _err_putHex(module >> 4);
+  _err_putHex(module);
+  _err_putHex(reason >> 4);
+  _err_putHex(reason);
+#ifdef ERR_VERBOSE
+  if (module < sizeof(_err_modules) / sizeof(_err_modules[0]) && reason < sizeof(_err_reasons) / sizeof(_err_reasons[0]))
+  {
+    uart0_putc(' ');
+    uart0_puts_P((PGM_P)pgm_read_word(&_err_modules[module]));
+    uart0_puts_P(PSTR(": "));
+    uart0_puts_P((PGM_P)pgm_read_word(&_err_reasons[reason]));
+  }
+#endif
+  uart0_putc('\n');
+}
+
+uint16_t err_getLast()
+{
+  uint16_t last;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  last = _err_last;
+  _err_last = 0;
+  if (bit)
+    sei();
+  return last;
+}
+
+uint16_t err_getCount()
+{
+  uint16_t count;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  count = _err_count;
+  if (bit)
+    sei();
+  return count;
+}
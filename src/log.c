@@ -0,0 +1,175 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <err.h>
+#include <tb.h>
+#include <tlm.h>
+#include <uart.h>
+#ifdef TLM_MUX
+#include <mux.h>
+#endif
+
+#include "log.h"
+
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 128
+#endif
+
+#if (LOG_BUFFER_SIZE > 256) || (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1))
+#error "LOG_BUFFER_SIZE must be a power of 2 and must not exceed 256"
+#endif
+
+#define LOG_MASK (LOG_BUFFER_SIZE - 1)
+#define LOG_DRAIN_INTERVAL_MS 10
+#define LOG_FRAME_OVERHEAD 11 // the bytes tlm_send adds to the payload: header, CRC, COBS and delimiters
+
+static uint8_t _log_initialized = 0;
+static uint8_t _log_buffer[LOG_BUFFER_SIZE];
+static volatile uint8_t _log_in = 0;
+static volatile uint8_t _log_out = 0;
+static volatile uint16_t _log_dropped = 0;  // since the start
+static volatile uint16_t _log_unreported = 0; // not yet reported by LOG_DROPPED
+static volatile uint8_t _log_draining = 0;
+
+// called by the timebase with interrupts enabled
+static uint16_t _log_drain()
+{
+  log_poll();
+  return LOG_DRAIN_INTERVAL_MS;
+}
+
+void log_init()
+{
+  if (_log_initialized)
+  {
+    err_report(ERR_M_LOG, ERR_R_ALREADY_INITIALIZED);
+    return;
+  }
+  _log_initialized = 1;
+
+  if (tb_isInitialized() && !tb_registerEx(_log_drain, LOG_DRAIN_INTERVAL_MS, TB_LOW_PRIORITY))
+  {
+    err_report(ERR_M_LOG, ERR_R_TB_REGISTER);
+  }
+}
+
+void log_put(uint8_t id, uint8_t count, uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+  uint8_t in, i;
+  uint16_t args[LOG_MAX_ARGS];
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  args[0] = a;
+  args[1] = b;
+  args[2] = c;
+  args[3] = d;
+  if (count > LOG_MAX_ARGS)
+    count = LOG_MAX_ARGS;
+
+  if (bit)
+    cli();
+  in = _log_in;
+  if (((uint8_t)(_log_out - in - 1) & LOG_MASK) < 2 + 2 * count)
+  {
+    if (_log_dropped < 0xFFFF)
+      _log_dropped++;
+    if (_log_unreported < 0xFFFF)
+      _log_unreported++;
+  }
+  else
+  {
+    _log_buffer[in] = id;
+    in = (in + 1) & LOG_MASK;
+    _log_buffer[in] = count;
+    in = (in + 1) & LOG_MASK;
+    for (i = 0; i < count; i++)
+    {
+      _log_buffer[in] = args[i];
+      in = (in + 1) & LOG_MASK;
+      _log_buffer[in] = args[i] >> 8;
+      in = (in + 1) & LOG_MASK;
+    }
+    _log_in = in;
+  }
+  if (bit)
+    sei();
+}
+
+void log_poll()
+{
+  uint8_t payload[TLM_MAX_PAYLOAD];
+  uint8_t length, size, out, i;
+  uint16_t unreported;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  if (_log_draining)
+  {
+    if (bit)
+      sei();
+    return;
+  }
+  _log_draining = 1;
+  if (bit)
+    sei();
+
+  while (1)
+  {
+    length = 0;
+    if (bit)
+      cli();
+    unreported = _log_unreported;
+    if (unreported)
+    {
+      payload[length++] = LOG_ID_LOG_DROPPED;
+      payload[length++] = 1;
+      payload[length++] = unreported;
+      payload[length++] = unreported >> 8;
+    }
+    // only complete records are sent; the writers only append, so the records are stable
+    out = _log_out;
+    if (bit)
+      sei();
+    while (out != _log_in)
+    {
+      size = 2 + 2 * _log_buffer[(out + 1) & LOG_MASK];
+      if (length + size > TLM_MAX_PAYLOAD)
+        break;
+      for (i = 0; i < size; i++)
+      {
+        payload[length++] = _log_buffer[out];
+        out = (out + 1) & LOG_MASK;
+      }
+    }
+
+    // check first, so that tlm_send does not count a record as dropped, which is sent later
+#ifdef TLM_MUX
+    if (!length || mux_getFree(MUX_CH_TLM) < length + LOG_FRAME_OVERHEAD || !tlm_send(TLM_T_LOG, payload, length))
+#else
+    if (!length || uart0_getTxFree() < length + LOG_FRAME_OVERHEAD || !tlm_send(TLM_T_LOG, payload, length))
+#endif
+      break;
+
+    if (bit)
+      cli();
+    _log_out = out;
+    _log_unreported -= unreported;
+    if (bit)
+      sei();
+  }
+  _log_draining = 0;
+}
+
+uint16_t log_getDropped()
+{
+  uint16_t dropped;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  dropped = _log_dropped;
+  if (bit)
+    sei();
+  return dropped;
+}
@@ -0,0 +1,399 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <string.h>
+
+#include <err.h>
+#include <tb.h>
+#include <uart.h>
+
+#include "mux.h"
+
+#if (MUX_QUEUE_SIZE > 256) || (MUX_QUEUE_SIZE & (MUX_QUEUE_SIZE - 1))
+#error "MUX_QUEUE_SIZE must be a power of 2 and must not exceed 256"
+#endif
+
+#define MUX_MASK (MUX_QUEUE_SIZE - 1)
+#define MUX_POLL_INTERVAL_MS 1
+#define MUX_FRAME_SIZE (1 + MUX_CHUNK_SIZE + 2)  // channel, data, CRC
+#define MUX_ENCODED_SIZE (MUX_FRAME_SIZE + 3)   // COBS adds one byte, plus the delimiters
+#define MUX_PRIORITY_DEFAULT 2
+#define MUX_CRC_INIT 0x1D0F // differs from the TLM frames, so that the receivers can tell them apart
+
+struct MuxQueue
+{
+  uint8_t data[MUX_QUEUE_SIZE];
+  volatile uint8_t in;
+  volatile uint8_t out;
+  volatile uint16_t dropped;
+  uint8_t priority;
+  uint8_t skips; // the number of chunks sent since the channel got data waiting
+  void (*receiver)(const uint8_t *pData, uint8_t length);
+};
+
+static uint8_t _mux_initialized = 0;
+static struct MuxQueue _mux_queue[MUX_CHANNELS];
+static uint8_t _mux_next = 0; // the channel that comes first among channels of the same priority
+static volatile uint8_t _mux_polling = 0;
+static TbHandle _mux_drainHandle = 0;
+static uint8_t _mux_drainStopped = 0; // the drain is stopped, since there is nothing to send or receive
+static uint8_t _mux_rxData[MUX_ENCODED_SIZE];
+static uint8_t _mux_rxLength = 0; // 0xFF: the current frame is too long and gets discarded
+
+// returns 1, if a receiver is set, i.e. the reception has to be polled
+static uint8_t _mux_receiving()
+{
+  uint8_t i;
+
+  for (i = 0; i < MUX_CHANNELS; i++)
+  {
+    if (_mux_queue[i].receiver)
+      return 1;
+  }
+  return 0;
+}
+
+// restarts the drain; must be called with interrupts disabled
+static void _mux_wake()
+{
+  if (_mux_drainStopped)
+  {
+    _mux_drainStopped = 0;
+    tb_startTimeout(_mux_drainHandle);
+  }
+}
+
+// called by the timebase with interrupts enabled; stops itself, when there is nothing left to do,
+// so that a tickless timebase is not woken up every millisecond
+static uint16_t _mux_drain()
+{
+  uint8_t i;
+
+  mux_poll();
+
+  cli();
+  for (i = 0; i < MUX_CHANNELS; i++)
+  {
+    if (_mux_queue[i].in != _mux_queue[i].out)
+      break;
+  }
+  if (i == MUX_CHANNELS && !_mux_receiving())
+  {
+    _mux_drainStopped = 1;
+    tb_stopTimeout(_mux_drainHandle); // restarted by _mux_put or mux_setReceiver
+  }
+  sei();
+  return MUX_POLL_INTERVAL_MS;
+}
+
+void mux_init()
+{
+  uint8_t i;
+
+  if (_mux_initialized)
+  {
+    err_report(ERR_M_MUX, ERR_R_ALREADY_INITIALIZED);
+    return;
+  }
+  _mux_initialized = 1;
+
+  for (i = 0; i < MUX_CHANNELS; i++)
+    _mux_queue[i].priority = MUX_PRIORITY_DEFAULT;
+  if (MUX_CH_CMD < MUX_CHANNELS)
+    _mux_queue[MUX_CH_CMD].priority = 0;
+  if (MUX_CH_TLM < MUX_CHANNELS)
+    _mux_queue[MUX_CH_TLM].priority = 1;
+
+  if (tb_isInitialized())
+  {
+    _mux_drainHandle = tb_registerEx(_mux_drain, MUX_POLL_INTERVAL_MS, TB_LOW_PRIORITY);
+    if (!_mux_drainHandle)
+      err_report(ERR_M_MUX, ERR_R_TB_REGISTER);
+  }
+}
+
+void mux_setPriority(uint8_t channel, uint8_t priority)
+{
+  if (channel >= MUX_CHANNELS)
+  {
+    err_report(ERR_M_MUX, ERR_R_INVALID_ARG);
+    return;
+  }
+  _mux_queue[channel].priority = priority;
+}
+
+// puts the data into the queue; pgm selects the flash memory as source
+static uint8_t _mux_put(uint8_t channel, const uint8_t *pData, uint8_t length, uint8_t pgm)
+{
+  struct MuxQueue *pQueue;
+  uint8_t in, i;
+  uint8_t result = 0;
+  uint8_t bit;
+
+  if (channel >= MUX_CHANNELS)
+    return 0;
+  pQueue = &_mux_queue[channel];
+
+  bit = bit_is_set(SREG, 7);
+  if (bit)
+    cli();
+  in = pQueue->in;
+  if (((uint8_t)(pQueue->out - in - 1) & MUX_MASK) >= length)
+  {
+    for (i = 0; i < length; i++)
+    {
+      pQueue->data[in] = pgm ? pgm_read_byte(pData + i) : pData[i];
+      in = (in + 1) & MUX_MASK;
+    }
+    pQueue->in = in;
+    result = 1;
+    _mux_wake();
+  }
+  else if (pQueue->dropped <= 0xFFFF - length)
+  {
+    pQueue->dropped += length;
+  }
+  else
+  {
+    pQueue->dropped = 0xFFFF;
+  }
+  if (bit)
+    sei();
+  return result;
+}
+
+uint8_t mux_write(uint8_t channel, const void *pData, uint8_t length)
+{
+  return _mux_put(channel, (const uint8_t *)pData, length, 0);
+}
+
+uint8_t mux_puts(uint8_t channel, const char *pString)
+{
+  return _mux_put(channel, (const uint8_t *)pString, strlen(pString), 0);
+}
+
+uint8_t mux_puts_P(uint8_t channel, const char *pString)
+{
+  return _mux_put(channel, (const uint8_t *)pString, strlen_P(pString), 1);
+}
+
+uint8_t mux_getFree(uint8_t channel)
+{
+  if (channel >= MUX_CHANNELS)
+    return 0;
+  return ((uint8_t)(_mux_queue[channel].out - _mux_queue[channel].in - 1)) & MUX_MASK;
+}
+
+uint16_t mux_getDropped(uint8_t channel)
+{
+  uint16_t dropped;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (channel >= MUX_CHANNELS)
+    return 0;
+  if (bit)
+    cli();
+  dropped = _mux_queue[channel].dropped;
+  if (bit)
+    sei();
+  return dropped;
+}
+
+void mux_setReceiver(uint8_t channel, void (*receiver)(const uint8_t *pData, uint8_t length))
+{
+  uint8_t bit;
+
+  if (channel >= MUX_CHANNELS)
+  {
+    err_report(ERR_M_MUX, ERR_R_INVALID_ARG);
+    return;
+  }
+  _mux_queue[channel].receiver = receiver;
+  if (receiver)
+  {
+    bit = bit_is_set(SREG, 7);
+    if (bit)
+      cli();
+    _mux_wake();
+    if (bit)
+      sei();
+  }
+}
+
+// picks the channel to send the next chunk of; 0xFF if all queues are empty
+static uint8_t _mux_schedule()
+{
+  uint8_t i, channel;
+  uint8_t best = 0xFF;
+
+  for (i = 0; i < MUX_CHANNELS; i++)
+  {
+    channel = _mux_next + i;
+    if (channel >= MUX_CHANNELS)
+      channel -= MUX_CHANNELS;
+    if (_mux_queue[channel].in == _mux_queue[channel].out)
+      continue;
+    if (_mux_queue[channel].skips >= MUX_MAX_SKIPS)
+      return channel; // starved
+    if (best == 0xFF || _mux_queue[channel].priority < _mux_queue[best].priority)
+      best = channel;
+  }
+  return best;
+}
+
+// sends the next chunk; returns 0 if there was nothing to send or not enough space in the transmission buffer
+static uint8_t _mux_send()
+{
+  uint8_t frame[MUX_FRAME_SIZE];
+  char encoded[MUX_ENCODED_SIZE];
+  uint8_t i, size, code, codeIndex, encodedSize, out, channel;
+  uint16_t crc = MUX_CRC_INIT;
+  struct MuxQueue *pQueue;
+  uint8_t result = 0;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (uart0_getTxFree() < MUX_ENCODED_SIZE)
+    return 0; // checked first, since composing a frame takes some time
+  channel = _mux_schedule();
+  if (channel == 0xFF)
+    return 0;
+  pQueue = &_mux_queue[channel];
+
+  // only mux_poll takes data out of the queues, so they can be read without disabling the interrupts
+  frame[0] = channel;
+  size = 1;
+  out = pQueue->out;
+  while (out != pQueue->in && size < 1 + MUX_CHUNK_SIZE)
+  {
+    frame[size++] = pQueue->data[out];
+    out = (out + 1) & MUX_MASK;
+  }
+  for (i = 0; i < size; i++)
+    crc = _crc_xmodem_update(crc, frame[i]);
+  frame[size++] = crc;
+  frame[size++] = crc >> 8;
+
+  // COBS like in tlm_send
+  encoded[0] = 0;
+  codeIndex = 1;
+  encodedSize = 2;
+  code = 1;
+  for (i = 0; i < size; i++)
+  {
+    if (frame[i])
+    {
+      encoded[encodedSize++] = frame[i];
+      code++;
+    }
+    else
+    {
+      encoded[codeIndex] = code;
+      codeIndex = encodedSize++;
+      code = 1;
+    }
+  }
+  encoded[codeIndex] = code;
+  encoded[encodedSize++] = 0;
+
+  if (bit)
+    cli();
+  if (uart0_getTxFree() >= encodedSize)
+  {
+    uart0_write(encoded, encodedSize);
+    pQueue->out = out;
+    result = 1;
+  }
+  if (bit)
+    sei();
+
+  if (result)
+  {
+    // the channels that had to wait come closer to being sent, the next round starts behind the sent channel
+    for (i = 0; i < MUX_CHANNELS; i++)
+    {
+      if (i == channel || _mux_queue[i].in == _mux_queue[i].out)
+        _mux_queue[i].skips = 0;
+      else if (_mux_queue[i].skips < 0xFF)
+        _mux_queue[i].skips++;
+    }
+    _mux_next = (channel + 1 < MUX_CHANNELS) ? channel + 1 : 0;
+  }
+  return result;
+}
+
+// decodes a received frame in place and passes it to the receiver of its channel
+static void _mux_dispatch(uint8_t *pData, uint8_t length)
+{
+  uint8_t i = 0, size = 0, code, j;
+  uint16_t crc = MUX_CRC_INIT;
+
+  while (i < length)
+  {
+    code = pData[i];
+    if (code == 0 || i + code > length)
+      return;
+    for (j = 1; j < code; j++)
+      pData[size++] = pData[i + j];
+    i += code;
+    if (code < 0xFF && i < length)
+      pData[size++] = 0;
+  }
+  if (size < 3)
+    return;
+  for (i = 0; i < size - 2; i++)
+    crc = _crc_xmodem_update(crc, pData[i]);
+  if ((pData[size - 2] | (pData[size - 1] << 8)) != crc)
+    return;
+  if (pData[0] < MUX_CHANNELS && _mux_queue[pData[0]].receiver)
+    _mux_queue[pData[0]].receiver(pData + 1, size - 3);
+}
+
+static void _mux_receive()
+{
+  char c;
+
+  if (!_mux_receiving())
+    return; // the reception is left to the application
+
+  while (uart0_getc_nb(&c))
+  {
+    if (c == 0)
+    {
+      if (_mux_rxLength && _mux_rxLength != 0xFF)
+        _mux_dispatch(_mux_rxData, _mux_rxLength);
+      _mux_rxLength = 0;
+    }
+    else if (_mux_rxLength < sizeof(_mux_rxData))
+    {
+      _mux_rxData[_mux_rxLength++] = c;
+    }
+    else
+    {
+      _mux_rxLength = 0xFF;
+    }
+  }
+}
+
+void mux_poll()
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  if (_mux_polling)
+  {
+    if (bit)
+      sei();
+    return;
+  }
+  _mux_polling = 1;
+  if (bit)
+    sei();
+
+  _mux_receive();
+  while (_mux_send())
+  {
+  }
+  _mux_polling = 0;
+}
@@ -1,5 +1,5 @@
 #include "spi.h"
-#include <uart.h>
+#include <err.h>
 
 static uint8_t spi_initialized = 0;
 
@@ -7,7 +7,7 @@ void spi_init()
 {
   if (spi_initialized)
   {
-    uart0_msg("spi_init: already initialized\n");
+    err_report(ERR_M_SPI, ERR_R_ALREADY_INITIALIZED);
     return;
   }
 
@@ -27,7 +27,7 @@ uint8_t spi_transceive(uint8_t data)
 {
   if (!spi_initialized)
   {
-    uart0_msg("spi_transceive: spi_init missing\n");
+    err_report(ERR_M_SPI, ERR_R_INIT_MISSING);
     return 0;
   }
   SPDR = data;
@@ -1,5 +1,6 @@
 #include "sr04.h"
 #include <avr/interrupt.h>
+#include <log.h>
 
 enum SR04SensorPhase
 {
@@ -112,6 +113,7 @@ ISR(PCINT2_vect)
                     {
                         sr04Distance_mm[j] = ((65535 - sr04Sensor[j].startTime + endTime) * 16) / 58;
                     }
+                    LOG2(SR04_ECHO, j, sr04Distance_mm[j]);
                 }
             }
             else if (sr04Sensor[j].phase != USS_STOP)
@@ -1,53 +1,397 @@
-
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <avr/pgmspace.h>
 
 #include "tb.h"
 #include <uart.h>
+#include <err.h>
+
+#define TB_NONE 0xFF // marks the end of the timer list
+
+#define TB_CONTEXT (1 << 3) // internal option: the callback expects a context pointer
+
+// tickless mode: timer 1 runs freely with PS=64, i.e. 4us per count
+#define TB_COUNTS_PER_MS 250
+#define TB_TICKLESS_MAX_MS 200 // the longest time between two interrupts; must stay below 65536 counts
+#define TB_TICKLESS_MARGIN 8   // counts a new compare value must at least lie ahead of the timer
+
+#define TB_LOAD_WINDOW_MS 100 // the CPU load is determined over windows of (at least) this length
 
 enum CallbackState
 {
   TB_FREE = 0,
   TB_ACTIVE = 1,
-  TB_REGISTER = 2,
+  TB_DUE = 2,
   TB_UNREGISTER = 3,
+  TB_PENDING = 4, // a deferred or low-priority callback waiting to be called with interrupts enabled
+};
+
+// The active callbacks are kept in a list that is sorted by their deadlines. Each entry stores
+// its deadline relative to its predecessor (delta_ms), so that a tick only needs to touch the
+// head of the list, unless callbacks expire. State, running and options share a single byte.
+union TbCallback
+{
+  uint16_t (*plain)();
+  uint16_t (*withCtx)(void *ctx);
 };
 
 struct TimeBaseCallbackInfo
 {
-  enum CallbackState state;
-  uint16_t ticks;
-  uint16_t actTick;
-  uint8_t running;
-  uint16_t (*callback)();
+  union TbCallback callback;
+  void *ctx;           // the context passed to callbacks registered by tb_registerCtx
+  uint16_t period_ms;  // the time the callback got scheduled with; restarted by tb_resetTimeout
+  uint16_t delta_ms;   // the time between the predecessor's deadline and the own one; the remaining time while stopped;
+                       // the timer counts of the deadline while pending (for the latency statistics)
+  uint16_t phase_ms;   // TB_PERIODIC: the deadlines lie at the times t with t % period_ms == phase_ms
+  uint8_t next;        // the next callback in the timer list
+  uint8_t state : 3;   // enum CallbackState
+  uint8_t running : 1;
+  uint8_t flags : 4;   // options given at the registration (TB_DEFERRED, TB_LOW_PRIORITY, TB_PERIODIC, TB_CONTEXT)
+  uint8_t generation;  // incremented on every registration; part of the handle
+#ifdef TB_PROFILING
+  uint16_t calls;      // the number of calls since the registration
+  uint16_t minTicks;   // the shortest execution time of the callback in timer counts
+  uint16_t maxTicks;   // the longest execution time of the callback in timer counts
+  uint32_t sumTicks;   // the accumulated execution time of the callback in timer counts
+#endif
 };
 
+#ifdef TB_MAX_CALLBACKS
+// the slots are allocated statically, which keeps the heap free for other modules
+static struct TimeBaseCallbackInfo _tbCallbackInfo[TB_MAX_CALLBACKS];
+#else
 static struct TimeBaseCallbackInfo *_tbCallbackInfo = NULL;
+#endif
 static uint8_t _tbCallbackNo = 0;
 static uint8_t _tbMaxCallbackNo = 0;
+static uint8_t _tbHead = TB_NONE; // the callback with the earliest deadline
 static uint16_t _tbBaseTime_ms = 0;
 static uint32_t _tbActTime_ms = 0;
+static uint32_t _tbCounts = 0; // the timer counts up to the last update of _tbActTime_ms
+
+static uint8_t _tbTickless = 0;      // is the timebase running in tickless mode
+static uint16_t _tbLastCount = 0;    // tickless mode: the timer value _tbActTime_ms refers to
+static uint16_t _tbStep_ms = 0;      // tickless mode: the time from _tbLastCount to the programmed compare match
+
+// queue of the deferred callbacks that are due; filled by the ISR and drained by tb_poll. Since
+// every callback can be pending only once, the queue cannot overflow.
+#ifdef TB_MAX_CALLBACKS
+static uint8_t _tbPending[TB_MAX_CALLBACKS + 1];
+#else
+static uint8_t *_tbPending = NULL;
+#endif
+static volatile uint8_t _tbPendingIn = 0;
+static volatile uint8_t _tbPendingOut = 0;
+
+// list of the low-priority callbacks that are due; filled by the ISR and drained at its end with
+// interrupts enabled. Only the outermost ISR drains the list, nested ones just append to it.
+static uint8_t _tbLowHead = TB_NONE;
+static uint8_t _tbLowTail = TB_NONE;
+static uint8_t _tbLowRunning = 0;
+
+#ifdef TB_PROFILING
+static uint16_t _tbOverruns = 0;       // how often the ISR ran past the next compare match
+static uint32_t _tbIsrTicks = 0;       // the time spent in the ISR in the current window
+static uint32_t _tbIsrTicksLast = 0;   // the time spent in the ISR in the last window
+static uint16_t _tbWindowLast_ms = 0;  // the length of the last window
+static uint32_t _tbWindowStart_ms = 0; // the start of the current window
+static uint16_t _tbMaxLatency[3];      // the longest delay from a deadline to the call for each priority level
+#endif
+
+// load monitor: tb_idle counts the iterations of the idle loop; the ISR compares them with the
+// count of an idle CPU, which tb_calibrateLoad determined, at the end of each window
+static volatile uint32_t _tbIdleCount = 0;
+static uint32_t _tbIdleRef = 0;             // the idle count of an idle CPU per TB_LOAD_WINDOW_MS; 0 if not calibrated
+static volatile uint8_t _tbLoadCalibrating = 0;
+static uint32_t _tbLoadStart_ms = 0;        // the start of the current window
+static uint16_t _tbLoadSecond_ms = 0;       // the time passed in the current second
+static uint8_t _tbLoad = 0;                 // the load of the last window in percent
+static uint8_t _tbLoadPeak = 0;             // the highest load of a window within the last second
+static uint8_t _tbLoadPeakAct = 0;          // the highest load of a window within the current second
 
 static uint8_t _tb_initialized = 0;
 
+// inserts the callback into the timer list, so that it expires in delay_ms milliseconds;
+// must be called with interrupts disabled
+static void _tb_insert(uint8_t index, uint16_t delay_ms)
+{
+  uint8_t *pLink = &_tbHead;
+  struct TimeBaseCallbackInfo *tbPtr;
+
+  while (*pLink != TB_NONE)
+  {
+    tbPtr = &_tbCallbackInfo[*pLink];
+    if (delay_ms < tbPtr->delta_ms)
+    {
+      tbPtr->delta_ms -= delay_ms;
+      break;
+    }
+    delay_ms -= tbPtr->delta_ms;
+    pLink = &tbPtr->next;
+  }
+  _tbCallbackInfo[index].delta_ms = delay_ms;
+  _tbCallbackInfo[index].next = *pLink;
+  *pLink = index;
+}
+
+// removes the callback from the timer list and returns the time left until its deadline;
+// must be called with interrupts disabled
+static uint16_t _tb_remove(uint8_t index)
+{
+  uint8_t *pLink = &_tbHead;
+  struct TimeBaseCallbackInfo *tbPtr;
+  uint16_t remaining_ms = 0;
+
+  while (*pLink != TB_NONE)
+  {
+    tbPtr = &_tbCallbackInfo[*pLink];
+    remaining_ms += tbPtr->delta_ms;
+    if (*pLink == index)
+    {
+      *pLink = tbPtr->next;
+      if (tbPtr->next != TB_NONE)
+      {
+        _tbCallbackInfo[tbPtr->next].delta_ms += tbPtr->delta_ms;
+      }
+      return remaining_ms;
+    }
+    pLink = &tbPtr->next;
+  }
+  return 0;
+}
+
+// TB_PERIODIC: returns the time from _tbActTime_ms to the callback's first deadline after elapsed_ms;
+// must be called with interrupts disabled
+static uint16_t _tb_phaseDelay(struct TimeBaseCallbackInfo *tbPtr, uint16_t elapsed_ms)
+{
+  uint16_t offset_ms = _tbActTime_ms % tbPtr->period_ms;
+  uint16_t delay_ms;
+
+  if (tbPtr->phase_ms >= offset_ms)
+    delay_ms = tbPtr->phase_ms - offset_ms;
+  else
+    delay_ms = tbPtr->period_ms - (offset_ms - tbPtr->phase_ms);
+  while (delay_ms <= elapsed_ms && delay_ms <= 0xFFFF - tbPtr->period_ms)
+    delay_ms += tbPtr->period_ms; // missed deadlines are skipped instead of being caught up in a burst
+  return delay_ms;
+}
+
+// puts a due callback back into the timer list or frees it, depending on the time period_ms it returned;
+// elapsed_ms is the time passed since the last update of the timebase; must be called with interrupts disabled
+static void _tb_reschedule(uint8_t index, uint16_t period_ms, uint16_t elapsed_ms)
+{
+  struct TimeBaseCallbackInfo *tbPtr = &_tbCallbackInfo[index];
+  uint16_t delay_ms = period_ms + elapsed_ms;
+
+  if (tbPtr->state == TB_UNREGISTER) // the callback got unregistered meanwhile
+  {
+    tbPtr->state = TB_FREE;
+  }
+  else if (!period_ms)
+  {
+    tbPtr->state = TB_FREE;
+    _tbCallbackNo--;
+  }
+  else
+  {
+    if (tbPtr->flags & TB_PERIODIC)
+    {
+      // called from the ISR with an unchanged period, the deadline is already on the grid; called
+      // from tb_poll, the next deadline must be looked up, since the call might have been late
+      if (tbPtr->state == TB_PENDING || period_ms != tbPtr->period_ms)
+      {
+        tbPtr->period_ms = period_ms;
+        tbPtr->phase_ms %= period_ms;
+        delay_ms = _tb_phaseDelay(tbPtr, elapsed_ms);
+      }
+      else
+      {
+        delay_ms = period_ms;
+      }
+    }
+    tbPtr->state = TB_ACTIVE;
+    tbPtr->period_ms = period_ms;
+    if (tbPtr->running)
+      _tb_insert(index, delay_ms);
+    else
+      tbPtr->delta_ms = period_ms; // the timeout got stopped meanwhile
+  }
+}
+
+// TB_PERIODIC: returns a phase for a callback with the given period, which is not used by other
+// periodic callbacks with the same period yet. The candidates are taken in bit-reversed order
+// (0, 1/2, 1/4, 3/4, 1/8, ... of the period), so that any number of callbacks gets spread evenly;
+// must be called with interrupts disabled
+static uint16_t _tb_autoPhase(uint16_t period_ms)
+{
+  uint8_t i, j, rev, used;
+  uint16_t phase_ms = 0;
+  uint16_t grid_ms = _tbTickless ? 1 : _tbBaseTime_ms;
+  struct TimeBaseCallbackInfo *tbPtr;
+
+  for (j = 0; j <= _tbMaxCallbackNo && j != 0xFF; j++)
+  {
+    for (i = 0, rev = 0; i < 8; i++)
+      if (j & (1 << i))
+        rev |= 0x80 >> i;
+    phase_ms = ((uint32_t)period_ms * rev >> 8) / grid_ms * grid_ms;
+
+    used = 0;
+    for (i = 0, tbPtr = _tbCallbackInfo; i < _tbMaxCallbackNo; i++, tbPtr++)
+    {
+      if ((tbPtr->state == TB_ACTIVE || tbPtr->state == TB_DUE || tbPtr->state == TB_PENDING) &&
+          (tbPtr->flags & TB_PERIODIC) && tbPtr->period_ms == period_ms && tbPtr->phase_ms == phase_ms)
+      {
+        used = 1;
+        break;
+      }
+    }
+    if (!used)
+      break;
+  }
+  return phase_ms;
+}
+
+// returns the time in milliseconds that passed since _tbActTime_ms got updated the last time;
+// must be called with interrupts disabled
+static uint16_t _tb_elapsed()
+{
+  if (!_tbTickless)
+    return 0; // in periodic mode, times are counted from the last tick
+  return (uint16_t)(TCNT1 - _tbLastCount) / TB_COUNTS_PER_MS;
+}
+
+// tickless mode: programs the compare match for the earliest deadline in the list;
+// must be called with interrupts disabled
+static void _tb_program()
+{
+  uint16_t step_ms = TB_TICKLESS_MAX_MS;
+  uint16_t oldStep_ms = _tbStep_ms;
+  uint16_t oldCompare = OCR1A;
+
+  if (!_tbTickless || (TIFR1 & (1 << OCF1A)))
+    return; // a pending compare match is handled by the ISR, which programs the next one
+  // OCR1A equals _tbLastCount, once the ISR has handled the match; otherwise a compare match that
+  // is about to occur is left alone, since the ISR would add the new step for the old match
+  if (oldCompare != _tbLastCount && (uint16_t)(oldCompare - TCNT1) <= TB_TICKLESS_MARGIN)
+    return;
+
+  if (_tbHead != TB_NONE && _tbCallbackInfo[_tbHead].delta_ms < step_ms)
+    step_ms = _tbCallbackInfo[_tbHead].delta_ms;
+  if (!step_ms)
+    step_ms = 1;
+
+  // the compare value must lie ahead of the timer; otherwise the match would occur one timer cycle too late
+  while (step_ms * TB_COUNTS_PER_MS < (uint16_t)(TCNT1 - _tbLastCount) + TB_TICKLESS_MARGIN)
+    step_ms++;
+
+  _tbStep_ms = step_ms;
+  OCR1A = _tbLastCount + step_ms * TB_COUNTS_PER_MS;
+
+  // the old compare value matched meanwhile; the ISR has to see the step that belongs to it
+  if (oldCompare != _tbLastCount && (TIFR1 & (1 << OCF1A)))
+  {
+    _tbStep_ms = oldStep_ms;
+    OCR1A = oldCompare;
+  }
+}
+
+// calls the callback of the given slot
+static inline uint16_t _tb_call(struct TimeBaseCallbackInfo *tbPtr)
+{
+  if (tbPtr->flags & TB_CONTEXT)
+    return tbPtr->callback.withCtx(tbPtr->ctx);
+  return tbPtr->callback.plain();
+}
+
+#ifdef TB_PROFILING
+// calls the callback of the given slot and records its execution time
+static uint16_t _tb_run(struct TimeBaseCallbackInfo *tbPtr)
+{
+  uint32_t start = tb_getTicks();
+  uint16_t period_ms = _tb_call(tbPtr);
+  uint32_t ticks = tb_getTicks() - start;
+
+  if (ticks > 0xFFFF)
+    ticks = 0xFFFF;
+  if (tbPtr->calls < 0xFFFF) // stop accumulating, before the mean value gets wrong
+  {
+    if (!tbPtr->calls || ticks < tbPtr->minTicks)
+      tbPtr->minTicks = ticks;
+    if (ticks > tbPtr->maxTicks)
+      tbPtr->maxTicks = ticks;
+    tbPtr->sumTicks += ticks;
+    tbPtr->calls++;
+  }
+  return period_ms;
+}
+
+// converts timer counts to microseconds
+static uint32_t _tb_ticksToUs(uint32_t ticks)
+{
+  return _tbTickless ? ticks * 4 : ticks * 16;
+}
+
+// records the delay from the deadline, given in timer counts, to the call of a callback
+static void _tb_latency(uint8_t level, uint16_t dueCounts)
+{
+  uint16_t ticks = (uint16_t)tb_getTicks() - dueCounts;
+
+  if (ticks > _tbMaxLatency[level])
+    _tbMaxLatency[level] = ticks;
+}
+#else
+#define _tb_run _tb_call
+#define _tb_latency(level, dueCounts)
+#endif
+
 void tb_debug()
 {
   uint8_t i;
   struct TimeBaseCallbackInfo *tbPtr = _tbCallbackInfo;
   static char text[64];
 
-  uart0_msg("tb-status\n");
+  uart0_msg_P(PSTR("tb-status\n"));
   for (i = 0; i < _tbMaxCallbackNo; i++)
   {
     if (tbPtr->state != TB_FREE)
     {
-      sprintf(text, "tb: %02d, %d, %04x, %d\n", i + 1, tbPtr->state, tbPtr->callback, tbPtr->ticks);
+      sprintf_P(text, PSTR("tb: %02d, %d, %04x, %d\n"), i + 1, tbPtr->state, tbPtr->callback.plain, tbPtr->period_ms);
       uart0_msg(text);
     }
     tbPtr++;
   }
-  uart0_msg("\n");
+  uart0_msg_P(PSTR("tb-list:"));
+  for (i = _tbHead; i != TB_NONE; i = _tbCallbackInfo[i].next)
+  {
+    sprintf_P(text, PSTR(" %02d(+%u)"), i + 1, _tbCallbackInfo[i].delta_ms);
+    uart0_msg(text);
+  }
+  uart0_msg_P(PSTR("\n"));
+  if (_tbIdleRef)
+  {
+    sprintf_P(text, PSTR("tb: load %u%%, peak %u%%\n"), tb_getLoad(), tb_getPeakLoad());
+    uart0_msg(text);
+  }
+#ifdef TB_PROFILING
+  uart0_msg_P(PSTR("tb-profile: slot, calls, min/mean/max us\n"));
+  for (i = 0, tbPtr = _tbCallbackInfo; i < _tbMaxCallbackNo; i++, tbPtr++)
+  {
+    if (tbPtr->state != TB_FREE && tbPtr->calls)
+    {
+      sprintf_P(text, PSTR("tb: %02d, %u, %lu/%lu/%lu\n"), i + 1, tbPtr->calls, _tb_ticksToUs(tbPtr->minTicks),
+              _tb_ticksToUs(tbPtr->sumTicks / tbPtr->calls), _tb_ticksToUs(tbPtr->maxTicks));
+      uart0_msg(text);
+    }
+  }
+  sprintf_P(text, PSTR("tb: overruns %u, isr %lu us/s\n"), tb_getOverruns(), tb_getIsrTime_us());
+  uart0_msg(text);
+  sprintf_P(text, PSTR("tb: max latency high/low/deferred %lu/%lu/%lu us\n"), tb_getMaxLatency_us(0),
+          tb_getMaxLatency_us(TB_LOW_PRIORITY), tb_getMaxLatency_us(TB_DEFERRED));
+  uart0_msg(text);
+#endif
+  uart0_msg_P(PSTR("\n"));
 }
 
 uint8_t tb_init(enum TB_BaseTime baseTime_ms, uint8_t maxCallbackNo)
@@ -57,30 +401,71 @@ uint8_t tb_init(enum TB_BaseTime baseTime_ms, uint8_t maxCallbackNo)
 
   if (_tb_initialized)
   {
-    uart0_msg("tb_init: already initialized\n");
+    err_report(ERR_M_TB, ERR_R_ALREADY_INITIALIZED);
     return 0;
   }
 
   _tbBaseTime_ms = (uint16_t)baseTime_ms;
   _tbActTime_ms = 0;
+  _tbCounts = 0;
+#ifdef TB_PROFILING
+  _tbOverruns = 0;
+  _tbIsrTicks = _tbIsrTicksLast = 0;
+  _tbWindowLast_ms = 0;
+  _tbWindowStart_ms = 0;
+  _tbMaxLatency[0] = _tbMaxLatency[1] = _tbMaxLatency[2] = 0;
+#endif
+  _tbLowHead = _tbLowTail = TB_NONE;
+  _tbLowRunning = 0;
+  _tbIdleCount = 0;
+  _tbLoadStart_ms = 0;
+  _tbLoadSecond_ms = 0;
+  _tbLoad = _tbLoadPeak = _tbLoadPeakAct = 0;
+  _tbTickless = (baseTime_ms == TB_TICKLESS);
 
   // 62.5ns * 160000 = 10ms
   // 62.5ns * 256(PS) * 625 = 10ms
+#ifndef TB_MAX_CALLBACKS
   if (_tbCallbackInfo != NULL)
   {
     free(_tbCallbackInfo);
     _tbCallbackInfo = NULL;
   }
+  if (_tbPending != NULL)
+  {
+    free(_tbPending);
+    _tbPending = NULL;
+  }
+#endif
 
   _tbCallbackNo = 0;
   _tbMaxCallbackNo = 0;
+  _tbHead = TB_NONE;
+  _tbPendingIn = _tbPendingOut = 0;
 
+#ifdef TB_MAX_CALLBACKS
+  if (maxCallbackNo <= TB_MAX_CALLBACKS)
+#else
   _tbCallbackInfo = (struct TimeBaseCallbackInfo *)malloc(sizeof(struct TimeBaseCallbackInfo) * maxCallbackNo);
-  if (_tbCallbackInfo != NULL)
+  _tbPending = (uint8_t *)malloc(maxCallbackNo + 1);
+  if (_tbCallbackInfo != NULL && _tbPending != NULL)
+#endif
   {
     TCCR1A = 0x00;
-    TCCR1B = (1 << WGM12) | (1 << CS12); // CTC mode; PS=256
-    OCR1A = 625 * (uint16_t)(baseTime_ms / 10);
+    if (_tbTickless)
+    {
+      // 62.5ns * 64(PS) * 250 = 1ms; the timer runs freely and OCR1A is set to the next deadline
+      TCCR1B = (1 << CS11) | (1 << CS10); // normal mode; PS=64
+      TCNT1 = 0;
+      _tbLastCount = 0;
+      _tbStep_ms = TB_TICKLESS_MAX_MS;
+      OCR1A = TB_TICKLESS_MAX_MS * TB_COUNTS_PER_MS;
+    }
+    else
+    {
+      TCCR1B = (1 << WGM12) | (1 << CS12); // CTC mode; PS=256
+      OCR1A = 625 * (uint16_t)(baseTime_ms / 10) - 1; // the timer is reset after OCR1A+1 counts
+    }
     TIMSK1 = (1 << OCIE1A);
 
     _tbMaxCallbackNo = maxCallbackNo;
@@ -89,6 +474,7 @@ uint8_t tb_init(enum TB_BaseTime baseTime_ms, uint8_t maxCallbackNo)
     for (i = 0; i < maxCallbackNo; i++)
     {
       tbPtr->state = TB_FREE;
+      tbPtr->generation = 0;
       tbPtr++;
     }
     sei();
@@ -97,7 +483,11 @@ uint8_t tb_init(enum TB_BaseTime baseTime_ms, uint8_t maxCallbackNo)
   {
     TCCR1A = 0x00; // turn timer off
     TCCR1B = 0x00;
-    uart0_msg("tb_init: too less memory\n");
+#ifdef TB_MAX_CALLBACKS
+    err_report(ERR_M_TB, ERR_R_INVALID_ARG);
+#else
+    err_report(ERR_M_TB, ERR_R_NO_MEMORY);
+#endif
 
     return 0;
   }
@@ -114,7 +504,7 @@ uint16_t tb_getBaseTime_ms()
 {
   if (!_tb_initialized)
   {
-    uart0_msg("tb_getBaseTime_ms: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
     return 0;
   }
   return _tbBaseTime_ms;
@@ -122,59 +512,280 @@ uint16_t tb_getBaseTime_ms()
 
 uint32_t tb_getTime_ms()
 {
-  return _tbActTime_ms;
+  uint32_t time_ms;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  time_ms = _tbActTime_ms + _tb_elapsed();
+  if (bit)
+    sei();
+  return time_ms;
+}
+
+uint32_t tb_getTicks()
+{
+  uint32_t ticks;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  if (_tbTickless)
+  {
+    // the timer is not reset on a compare match; a pending match does not matter
+    ticks = _tbCounts + (uint16_t)(TCNT1 - _tbLastCount);
+  }
+  else
+  {
+    ticks = _tbCounts + TCNT1;
+    if (TIFR1 & (1 << OCF1A)) // the timer got reset, but the ISR did not run yet
+    {
+      ticks = _tbCounts + OCR1A + 1 + TCNT1;
+    }
+  }
+  if (bit)
+    sei();
+  return ticks;
+}
+
+uint32_t tb_getTime_us()
+{
+  if (_tbTickless)
+    return tb_getTicks() * 4; // 62.5ns * 64(PS)
+  return tb_getTicks() * 16;  // 62.5ns * 256(PS)
+}
+
+uint32_t tb_getTimeToInterrupt_us()
+{
+  uint16_t counts;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  counts = OCR1A - TCNT1; // the timer counts up to the compare value in both modes
+  if (TIFR1 & (1 << OCF1A))
+    counts = 0; // the interrupt is pending
+  if (bit)
+    sei();
+  if (_tbTickless)
+    return counts * 4UL;
+  return counts * 16UL;
+}
+
+// called by the ISR; determines the CPU load at the end of each window
+static void _tb_updateLoad()
+{
+  uint16_t window_ms = _tbActTime_ms - _tbLoadStart_ms;
+  uint32_t idle, expected;
+
+  if (window_ms < TB_LOAD_WINDOW_MS)
+    return;
+  idle = _tbIdleCount;
+  _tbIdleCount = 0;
+  _tbLoadStart_ms = _tbActTime_ms;
+
+  if (_tbLoadCalibrating) // the first window only aligns the measurement with the windows
+  {
+    if (--_tbLoadCalibrating == 0)
+      _tbIdleRef = idle * TB_LOAD_WINDOW_MS / window_ms;
+    return;
+  }
+  if (!_tbIdleRef)
+    return;
+
+  expected = _tbIdleRef * window_ms / TB_LOAD_WINDOW_MS;
+  _tbLoad = (idle >= expected) ? 0 : 100 - idle * 100 / expected;
+  if (_tbLoad > _tbLoadPeakAct)
+    _tbLoadPeakAct = _tbLoad;
+  _tbLoadSecond_ms += window_ms;
+  if (_tbLoadSecond_ms >= 1000)
+  {
+    _tbLoadPeak = _tbLoadPeakAct;
+    _tbLoadPeakAct = 0;
+    _tbLoadSecond_ms = 0;
+  }
 }
 
 ISR(TIMER1_COMPA_vect)
 {
-  uint8_t i, callbacksFound = 0;
+  uint8_t i, due;
+  uint8_t *pDueTail = &due;
+  uint16_t elapsed_ms = _tbBaseTime_ms;
+  uint16_t period_ms;
   struct TimeBaseCallbackInfo *tbPtr;
 
-  _tbActTime_ms += _tbBaseTime_ms;
+  if (_tbTickless)
+  {
+    elapsed_ms = _tbStep_ms;
+    _tbCounts += (uint16_t)(OCR1A - _tbLastCount);
+    _tbLastCount = OCR1A;
+  }
+  else
+  {
+    _tbCounts += OCR1A + 1;
+  }
+  _tbActTime_ms += elapsed_ms;
+  _tb_updateLoad();
+
+#ifdef TB_PROFILING
+  if (_tbActTime_ms - _tbWindowStart_ms >= 1000)
+  {
+    _tbWindowLast_ms = _tbActTime_ms - _tbWindowStart_ms;
+    _tbWindowStart_ms = _tbActTime_ms;
+    _tbIsrTicksLast = _tbIsrTicks;
+    _tbIsrTicks = 0;
+  }
+#endif
 
-  // free timers that shall be freed
-  for (i = 0, tbPtr = _tbCallbackInfo; i < _tbMaxCallbackNo; i++)
+  // detach the callbacks whose deadlines have been reached; when no callback
+  // expires, only the head of the list gets touched
+  while (_tbHead != TB_NONE && _tbCallbackInfo[_tbHead].delta_ms <= elapsed_ms)
   {
-    if (tbPtr->state == TB_REGISTER)
-      tbPtr->state = TB_ACTIVE;
-    else if (tbPtr->state == TB_UNREGISTER)
-      tbPtr->state = TB_FREE;
-    tbPtr++;
+    tbPtr = &_tbCallbackInfo[_tbHead];
+    elapsed_ms -= tbPtr->delta_ms;
+    tbPtr->state = TB_DUE;
+    *pDueTail = _tbHead;
+    pDueTail = &tbPtr->next;
+    _tbHead = tbPtr->next;
+  }
+  *pDueTail = TB_NONE;
+  if (_tbHead != TB_NONE)
+  {
+    _tbCallbackInfo[_tbHead].delta_ms -= elapsed_ms;
   }
 
-  for (i = 0, tbPtr = _tbCallbackInfo; (callbacksFound < _tbCallbackNo) && (i < _tbMaxCallbackNo); i++)
+  // call the detached callbacks and put them back into the list;
+  // deferred callbacks are handed over to tb_poll instead
+  while (due != TB_NONE)
   {
-    if (tbPtr->state == TB_ACTIVE)
+    i = due;
+    tbPtr = &_tbCallbackInfo[i];
+    due = tbPtr->next;
+
+    if (tbPtr->state == TB_DUE && tbPtr->running)
     {
-      callbacksFound++;
-      if (tbPtr->running)
+      if (tbPtr->flags & TB_DEFERRED)
       {
-        tbPtr->actTick++;
-        if (tbPtr->actTick >= tbPtr->ticks)
-        {
-          tbPtr->actTick = 0;
-          tbPtr->ticks = tbPtr->callback() / _tbBaseTime_ms;
-          if (!tbPtr->ticks)
-          {
-            tbPtr->state = TB_UNREGISTER;
-            _tbCallbackNo--;
-            callbacksFound--; // bug corrected -> 25.6.2018
-          }
-        }
+        tbPtr->state = TB_PENDING;
+        tbPtr->delta_ms = (uint16_t)_tbCounts;
+        _tbPending[_tbPendingIn] = i;
+        _tbPendingIn = (_tbPendingIn == _tbMaxCallbackNo) ? 0 : _tbPendingIn + 1;
+        continue;
       }
+      if (tbPtr->flags & TB_LOW_PRIORITY)
+      {
+        tbPtr->state = TB_PENDING;
+        tbPtr->delta_ms = (uint16_t)_tbCounts;
+        tbPtr->next = TB_NONE;
+        if (_tbLowHead == TB_NONE)
+          _tbLowHead = i;
+        else
+          _tbCallbackInfo[_tbLowTail].next = i;
+        _tbLowTail = i;
+        continue;
+      }
+      _tb_latency(0, (uint16_t)_tbCounts);
+      period_ms = _tb_run(tbPtr);
     }
-    tbPtr++;
+    else
+    {
+      period_ms = tbPtr->period_ms; // stopped or unregistered by a preceding callback
+    }
+    _tb_reschedule(i, period_ms, 0); // counted from the deadline, not from the callback's return
+  }
+
+#ifdef TB_PROFILING
+  {
+    // _tbCounts holds the time of the compare match that triggered the ISR
+    uint32_t isrTicks = tb_getTicks() - _tbCounts;
+
+    if (_tbTickless ? (_tbHead != TB_NONE && _tbCallbackInfo[_tbHead].delta_ms < TB_TICKLESS_MAX_MS &&
+                       isrTicks >= _tbCallbackInfo[_tbHead].delta_ms * TB_COUNTS_PER_MS)
+                    : (isrTicks > OCR1A))
+      _tbOverruns++;
+    _tbIsrTicks += isrTicks;
+  }
+#endif
+  _tb_program();
+
+  // the low-priority callbacks run with interrupts enabled, so that they can be interrupted by
+  // other interrupts and by the next timebase interrupt with its high-priority callbacks
+  if (_tbLowRunning)
+    return;
+  _tbLowRunning = 1;
+  while (_tbLowHead != TB_NONE)
+  {
+    i = _tbLowHead;
+    tbPtr = &_tbCallbackInfo[i];
+    _tbLowHead = tbPtr->next;
+
+    if (tbPtr->state == TB_PENDING && tbPtr->running)
+    {
+      sei();
+      _tb_latency(1, tbPtr->delta_ms);
+      period_ms = _tb_run(tbPtr);
+      cli();
+    }
+    else
+    {
+      period_ms = tbPtr->period_ms;
+    }
+    _tb_reschedule(i, period_ms, _tb_elapsed());
+    _tb_program();
+  }
+  _tbLowRunning = 0;
+}
+
+uint8_t tb_poll()
+{
+  uint8_t i, bit, calls = 0;
+  uint16_t period_ms;
+  struct TimeBaseCallbackInfo *tbPtr;
+
+  while (_tbPendingOut != _tbPendingIn)
+  {
+    i = _tbPending[_tbPendingOut];
+    _tbPendingOut = (_tbPendingOut == _tbMaxCallbackNo) ? 0 : _tbPendingOut + 1;
+    tbPtr = &_tbCallbackInfo[i];
+
+    if (tbPtr->state == TB_PENDING && tbPtr->running)
+    {
+      _tb_latency(2, tbPtr->delta_ms);
+      period_ms = _tb_run(tbPtr); // runs with interrupts enabled
+      calls++;
+    }
+    else
+    {
+      period_ms = tbPtr->period_ms;
+    }
+
+    bit = bit_is_set(SREG, 7);
+    if (bit)
+      cli();
+    _tb_reschedule(i, period_ms, _tb_elapsed());
+    _tb_program();
+    if (bit)
+      sei();
   }
+  return calls;
 }
 
-uint8_t tb_register(uint16_t (*callback)(), uint16_t time_ms)
+// registers a function with or without context; a generation counter per slot makes the handle
+// of an unregistered function invalid, even when its slot got reused meanwhile
+static TbHandle _tb_register(union TbCallback callback, void *ctx, uint16_t time_ms, uint8_t flags)
 {
   uint8_t i;
   struct TimeBaseCallbackInfo *tbPtr = _tbCallbackInfo;
 
   if (!_tb_initialized)
   {
-    uart0_msg("tb_register: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
+    return 0;
+  }
+
+  if (!time_ms)
+  {
+    err_report(ERR_M_TB, ERR_R_INVALID_ARG);
     return 0;
   }
 
@@ -187,108 +798,375 @@ uint8_t tb_register(uint16_t (*callback)(), uint16_t time_ms)
     if (tbPtr->state == TB_FREE)
     {
       tbPtr->callback = callback;
+      tbPtr->ctx = ctx;
       tbPtr->running = 1;
-      tbPtr->ticks = time_ms / _tbBaseTime_ms;
-      if (!tbPtr->ticks || time_ms % _tbBaseTime_ms)
-      {
-        uart0_msg("tb_register: invalid time_ms - must be a multiple of the basetime\n");
-        if (bit)
-          sei();
-        return 0;
-      }
-      tbPtr->state = TB_REGISTER;
-      tbPtr->actTick = 0;
+      tbPtr->flags = flags;
+      tbPtr->period_ms = time_ms;
+      if (flags & TB_PERIODIC)
+        tbPtr->phase_ms = _tb_autoPhase(time_ms);
+      tbPtr->state = TB_ACTIVE;
+      tbPtr->generation++;
+#ifdef TB_PROFILING
+      tbPtr->calls = tbPtr->maxTicks = 0;
+      tbPtr->sumTicks = 0;
+#endif
+      if (flags & TB_PERIODIC)
+        _tb_insert(i, _tb_phaseDelay(tbPtr, _tb_elapsed()));
+      else
+        _tb_insert(i, time_ms + _tb_elapsed());
+      _tb_program();
       _tbCallbackNo++;
       if (bit)
         sei();
-      return i + 1;
+      return ((TbHandle)tbPtr->generation << 8) | (i + 1);
     }
     tbPtr++;
   }
-  uart0_msg("tb_register: cannot register callback; increase maxCallbacks in tb_init\n");
+  err_report(ERR_M_TB, ERR_R_NO_SLOT);
   if (bit)
     sei();
   return 0;
 }
 
-uint8_t tb_unregister(uint8_t handle)
+// returns the slot of a registered function or TB_NONE, if the handle is invalid or stale
+static uint8_t _tb_getSlot(TbHandle handle)
+{
+  uint8_t index = (uint8_t)handle - 1;
+
+  if (index >= _tbMaxCallbackNo || _tbCallbackInfo[index].generation != (uint8_t)(handle >> 8))
+    return TB_NONE;
+  if (_tbCallbackInfo[index].state == TB_FREE || _tbCallbackInfo[index].state == TB_UNREGISTER)
+    return TB_NONE;
+  return index;
+}
+
+TbHandle tb_register(uint16_t (*callback)(), uint16_t time_ms)
+{
+  return tb_registerEx(callback, time_ms, 0);
+}
+
+TbHandle tb_registerEx(uint16_t (*callback)(), uint16_t time_ms, uint8_t flags)
+{
+  union TbCallback cb;
+
+  cb.plain = callback;
+  return _tb_register(cb, NULL, time_ms, flags & ~TB_CONTEXT);
+}
+
+TbHandle tb_registerCtx(uint16_t (*callback)(void *ctx), void *ctx, uint16_t time_ms)
+{
+  return tb_registerCtxEx(callback, ctx, time_ms, 0);
+}
+
+TbHandle tb_registerCtxEx(uint16_t (*callback)(void *ctx), void *ctx, uint16_t time_ms, uint8_t flags)
+{
+  union TbCallback cb;
+
+  cb.withCtx = callback;
+  return _tb_register(cb, ctx, time_ms, flags | TB_CONTEXT);
+}
+
+uint8_t tb_unregister(TbHandle handle)
 {
   uint8_t bit = bit_is_set(SREG, 7);
+  uint8_t index;
+  struct TimeBaseCallbackInfo *tbPtr;
 
   if (!_tb_initialized)
   {
-    uart0_msg("tb_unregister: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
     return 0;
   }
 
   if (bit)
     cli();
-  handle--;
-  if (handle < _tbMaxCallbackNo && _tbCallbackInfo[handle].ticks)
+  index = _tb_getSlot(handle);
+  if (index != TB_NONE)
   {
-    _tbCallbackInfo[handle].state = TB_UNREGISTER;
+    tbPtr = &_tbCallbackInfo[index];
+    if (tbPtr->state != TB_ACTIVE) // the ISR or tb_poll is about to call it; let them free it
+    {
+      tbPtr->state = TB_UNREGISTER;
+    }
+    else
+    {
+      if (tbPtr->running)
+      {
+        _tb_remove(index);
+        _tb_program();
+      }
+      tbPtr->state = TB_FREE;
+    }
     _tbCallbackNo--;
     if (bit)
       sei();
     return 1;
   }
 
-  uart0_msg("tb_unregister: invalid handle\n");
+  err_report(ERR_M_TB, ERR_R_INVALID_HANDLE);
+  if (bit)
+    sei();
+  return 0;
+}
+
+uint8_t tb_resetTimeout(TbHandle handle)
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+  uint8_t index;
+  struct TimeBaseCallbackInfo *tbPtr;
+
+  if (!_tb_initialized)
+  {
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
+    return 0;
+  }
+
+  if (bit)
+    cli();
+  index = _tb_getSlot(handle);
+  if (index != TB_NONE)
+  {
+    tbPtr = &_tbCallbackInfo[index];
+    if (tbPtr->state == TB_ACTIVE) // a due callback gets rescheduled anyway
+    {
+      if (tbPtr->running)
+      {
+        _tb_remove(index);
+        if (tbPtr->flags & TB_PERIODIC) // the next deadline on the grid, that is at least a period ahead
+          _tb_insert(index, _tb_phaseDelay(tbPtr, _tb_elapsed() + tbPtr->period_ms - 1));
+        else
+          _tb_insert(index, tbPtr->period_ms + _tb_elapsed());
+        _tb_program();
+      }
+      else
+      {
+        tbPtr->delta_ms = tbPtr->period_ms;
+      }
+    }
+    if (bit)
+      sei();
+    return 1;
+  }
+  err_report(ERR_M_TB, ERR_R_INVALID_HANDLE);
   if (bit)
     sei();
   return 0;
 }
 
-uint8_t tb_resetTimeout(uint8_t handle)
+uint8_t tb_stopTimeout(TbHandle handle)
 {
+  uint8_t bit = bit_is_set(SREG, 7);
+  uint8_t index;
+  uint16_t remaining_ms, elapsed_ms;
+  struct TimeBaseCallbackInfo *tbPtr;
+
   if (!_tb_initialized)
   {
-    uart0_msg("tb_resetTimeout: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
     return 0;
   }
 
-  handle--;
-  if (handle < _tbCallbackNo)
+  if (bit)
+    cli();
+  index = _tb_getSlot(handle);
+  if (index != TB_NONE)
   {
-    _tbCallbackInfo[handle].actTick = 0;
+    tbPtr = &_tbCallbackInfo[index];
+    if (tbPtr->running && tbPtr->state == TB_ACTIVE)
+    {
+      remaining_ms = _tb_remove(index);
+      elapsed_ms = _tb_elapsed();
+      tbPtr->delta_ms = (remaining_ms > elapsed_ms) ? remaining_ms - elapsed_ms : 0; // remember the remaining time
+      _tb_program();
+    }
+    tbPtr->running = 0;
+    if (bit)
+      sei();
     return 1;
   }
-  uart0_msg("tb_resetTimeout: invalid handle\n");
+  err_report(ERR_M_TB, ERR_R_INVALID_HANDLE);
+  if (bit)
+    sei();
   return 0;
 }
 
-uint8_t tb_stopTimeout(uint8_t handle)
+uint8_t tb_startTimeout(TbHandle handle)
 {
+  uint8_t bit = bit_is_set(SREG, 7);
+  uint8_t index;
+  struct TimeBaseCallbackInfo *tbPtr;
+
   if (!_tb_initialized)
   {
-    uart0_msg("tb_stopTimeout: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
     return 0;
   }
 
-  handle--;
-  if (handle < _tbCallbackNo)
+  if (bit)
+    cli();
+  index = _tb_getSlot(handle);
+  if (index != TB_NONE)
   {
-    _tbCallbackInfo[handle].running = 0;
+    tbPtr = &_tbCallbackInfo[index];
+    if (!tbPtr->running && tbPtr->state == TB_ACTIVE)
+    {
+      if (tbPtr->flags & TB_PERIODIC) // stay on the grid
+        _tb_insert(index, _tb_phaseDelay(tbPtr, _tb_elapsed() + (tbPtr->delta_ms ? tbPtr->delta_ms - 1 : 0)));
+      else
+        _tb_insert(index, tbPtr->delta_ms + _tb_elapsed());
+      _tb_program();
+    }
+    tbPtr->running = 1;
+    if (bit)
+      sei();
     return 1;
   }
-  uart0_msg("tb_stopTimeout: invalid handle\n");
+  err_report(ERR_M_TB, ERR_R_INVALID_HANDLE);
+  if (bit)
+    sei();
   return 0;
 }
 
-uint8_t tb_startTimeout(uint8_t handle)
+void tb_idle()
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+  if (bit)
+    cli();
+  _tbIdleCount++;
+  if (bit)
+    sei();
+}
+
+uint8_t tb_calibrateLoad()
 {
   if (!_tb_initialized)
   {
-    uart0_msg("tb_startTimeout: tb_init missing\n");
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
+    return 0;
+  }
+  if (!bit_is_set(SREG, 7))
+  {
+    err_report(ERR_M_TB, ERR_R_INTERRUPTS_DISABLED);
     return 0;
   }
 
-  handle--;
-  if (handle < _tbCallbackNo)
+  _tbIdleRef = 0;
+  _tbLoadCalibrating = 2;
+  while (_tbLoadCalibrating)
+    tb_idle();
+  if (!_tbIdleRef)
+  {
+    err_report(ERR_M_TB, ERR_R_FAILED);
+    return 0;
+  }
+  return 1;
+}
+
+uint8_t tb_getLoad()
+{
+  return _tbLoad;
+}
+
+uint8_t tb_getPeakLoad()
+{
+  return _tbLoadPeak;
+}
+
+uint8_t tb_setPhase(TbHandle handle, uint16_t phase_ms)
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+  uint8_t index;
+  struct TimeBaseCallbackInfo *tbPtr;
+
+  if (!_tb_initialized)
+  {
+    err_report(ERR_M_TB, ERR_R_INIT_MISSING);
+    return 0;
+  }
+
+  if (bit)
+    cli();
+  index = _tb_getSlot(handle);
+  if (index != TB_NONE && (_tbCallbackInfo[index].flags & TB_PERIODIC))
   {
-    _tbCallbackInfo[handle].running = 1;
+    tbPtr = &_tbCallbackInfo[index];
+    tbPtr->phase_ms = phase_ms % tbPtr->period_ms;
+    if (tbPtr->running && tbPtr->state == TB_ACTIVE) // a due callback gets moved by its rescheduling
+    {
+      _tb_remove(index);
+      _tb_insert(index, _tb_phaseDelay(tbPtr, _tb_elapsed()));
+      _tb_program();
+    }
+    if (bit)
+      sei();
     return 1;
   }
-  uart0_msg("tb_startTimeout: invalid handle\n");
+  err_report(ERR_M_TB, ERR_R_INVALID_HANDLE);
+  if (bit)
+    sei();
   return 0;
 }
+
+#ifdef TB_PROFILING
+uint8_t tb_getProfile(TbHandle handle, struct TbProfile *pProfile)
+{
+  uint8_t index;
+  struct TimeBaseCallbackInfo *tbPtr;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  index = _tb_getSlot(handle);
+  if (index == TB_NONE)
+  {
+    if (bit)
+      sei();
+    return 0;
+  }
+  tbPtr = &_tbCallbackInfo[index];
+  pProfile->calls = tbPtr->calls;
+  pProfile->min_us = _tb_ticksToUs(tbPtr->minTicks);
+  pProfile->max_us = _tb_ticksToUs(tbPtr->maxTicks);
+  pProfile->mean_us = tbPtr->calls ? _tb_ticksToUs(tbPtr->sumTicks / tbPtr->calls) : 0;
+  if (bit)
+    sei();
+  return 1;
+}
+
+uint16_t tb_getOverruns()
+{
+  return _tbOverruns;
+}
+
+uint32_t tb_getIsrTime_us()
+{
+  uint32_t ticks;
+  uint16_t window_ms;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  ticks = _tbIsrTicksLast;
+  window_ms = _tbWindowLast_ms;
+  if (bit)
+    sei();
+
+  if (!window_ms)
+    return 0;
+  return _tb_ticksToUs(ticks) * 1000 / window_ms; // normalized to one second
+}
+
+uint32_t tb_getMaxLatency_us(uint8_t priority)
+{
+  uint16_t ticks;
+  uint8_t level = (priority & TB_DEFERRED) ? 2 : (priority & TB_LOW_PRIORITY) ? 1 : 0;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  ticks = _tbMaxLatency[level];
+  if (bit)
+    sei();
+  return _tb_ticksToUs(ticks);
+}
+#endif
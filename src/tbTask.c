@@ -0,0 +1,43 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <tb.h>
+#include "tbTask.h"
+
+// called by the timebase; the task returns the time until it wants to be resumed, or 0 when it is done
+static uint16_t _tbTask_resume(void *ctx)
+{
+  struct TbTask *task = (struct TbTask *)ctx;
+
+  return task->body(task);
+}
+
+uint8_t tbTask_start(struct TbTask *task, uint16_t (*body)(struct TbTask *task), uint8_t flags)
+{
+  tbTask_stop(task);
+
+  task->lc = 0;
+  task->body = body;
+  task->handle = tb_registerCtxEx(_tbTask_resume, task, 1, flags);
+  return task->handle != 0;
+}
+
+void tbTask_stop(struct TbTask *task)
+{
+  uint8_t bit = bit_is_set(SREG, 7);
+  if (bit)
+    cli();
+  if (task->handle)
+  {
+    tb_unregister(task->handle);
+    task->handle = 0;
+    task->lc = 0;
+  }
+  if (bit)
+    sei();
+}
+
+uint8_t tbTask_isRunning(struct TbTask *task)
+{
+  return task->handle != 0;
+}
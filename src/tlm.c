@@ -0,0 +1,124 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+#include <tb.h>
+#include <uart.h>
+
+#ifdef TLM_MUX
+#include <mux.h>
+#endif
+
+#include "tlm.h"
+
+#define TLM_HEADER_SIZE 6 // type, sequence number, timestamp
+#define TLM_FRAME_SIZE (TLM_HEADER_SIZE + TLM_MAX_PAYLOAD + 2)
+
+static uint8_t _tlm_seq = 0;
+static uint16_t _tlm_dropped = 0;
+
+void tlm_init(uint32_t baudrate)
+{
+  uart0_init(baudrate, UART_M_TRANSCEIVE, UART_P_NONE);
+}
+
+uint8_t tlm_send(uint8_t type, const void *pPayload, uint8_t length)
+{
+  uint8_t frame[TLM_FRAME_SIZE];
+  char encoded[TLM_FRAME_SIZE + 3]; // COBS adds one byte (frames are shorter than 254 bytes) plus the delimiters
+  uint8_t i, size, code, codeIndex, encodedSize;
+  uint16_t crc = 0xFFFF;
+  uint32_t time_us = tb_isInitialized() ? tb_getTime_us() : 0;
+  uint8_t result = 0;
+  uint8_t bit;
+
+  if (length > TLM_MAX_PAYLOAD)
+    length = TLM_MAX_PAYLOAD;
+
+  // compose the frame
+  frame[0] = type;
+  frame[2] = time_us;
+  frame[3] = time_us >> 8;
+  frame[4] = time_us >> 16;
+  frame[5] = time_us >> 24;
+  for (i = 0; i < length; i++)
+    frame[TLM_HEADER_SIZE + i] = ((const uint8_t *)pPayload)[i];
+  size = TLM_HEADER_SIZE + length;
+
+  bit = bit_is_set(SREG, 7);
+  if (bit)
+    cli();
+  frame[1] = _tlm_seq++;
+  if (bit)
+    sei(); // the frame is encoded with interrupts enabled, so that the reception does not overrun
+
+  for (i = 0; i < size; i++)
+    crc = _crc_xmodem_update(crc, frame[i]);
+  frame[size++] = crc;
+  frame[size++] = crc >> 8;
+
+  // COBS: every 0 is replaced by the distance to the next 0; the frame starts and ends with a 0,
+  // so that text sent in between does not get merged with the frame
+  encoded[0] = 0;
+  codeIndex = 1;
+  encodedSize = 2;
+  code = 1;
+  for (i = 0; i < size; i++)
+  {
+    if (frame[i])
+    {
+      encoded[encodedSize++] = frame[i];
+      code++;
+    }
+    else
+    {
+      encoded[codeIndex] = code;
+      codeIndex = encodedSize++;
+      code = 1;
+    }
+  }
+  encoded[codeIndex] = code;
+  encoded[encodedSize++] = 0;
+
+  if (bit)
+    cli(); // records sent by interrupts must not get in between
+#ifdef TLM_MUX
+  result = mux_write(MUX_CH_TLM, encoded, encodedSize);
+#else
+  if (uart0_getTxFree() >= encodedSize)
+  {
+    uart0_write(encoded, encodedSize);
+    result = 1;
+  }
+#endif
+  if (!result && _tlm_dropped < 0xFFFF)
+  {
+    _tlm_dropped++;
+  }
+  if (bit)
+    sei();
+  return result;
+}
+
+uint8_t tlm_sendDistances(uint8_t type, const struct DbDistances *pDistances)
+{
+  return tlm_send(type, pDistances, sizeof(struct DbDistances));
+}
+
+uint8_t tlm_sendColors(const struct DbCsColors *pColors)
+{
+  return tlm_send(TLM_T_COLORS, pColors, sizeof(struct DbCsColors));
+}
+
+uint16_t tlm_getDropped()
+{
+  uint16_t dropped;
+  uint8_t bit = bit_is_set(SREG, 7);
+
+  if (bit)
+    cli();
+  dropped = _tlm_dropped;
+  if (bit)
+    sei();
+  return dropped;
+}
@@ -1,13 +1,69 @@
 #include "uart.h"
 #include <avr/interrupt.h>
+#include <avr/cpufunc.h>
+#include <avr/pgmspace.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
+
+// ----------------------------------------------------------------------------
+// ring buffer for the interrupt-driven transmission and reception; shared by all UARTs
+// ----------------------------------------------------------------------------
+struct UartRing
+{
+    char *pData;
+    uint8_t size;
+    volatile uint8_t in;         // the index the next character gets written to
+    volatile uint8_t out;        // the index the next character gets read from
+    volatile uint16_t overflows; // the number of characters that got lost
+};
+
+// puts a character into the ring buffer; must be called with interrupts disabled
+static inline uint8_t _uart_ringPut(struct UartRing *pRing, char c)
+{
+    uint8_t next = (pRing->in + 1 == pRing->size) ? 0 : pRing->in + 1;
+
+    if (next == pRing->out)
+        return 0; // full
+    pRing->pData[pRing->in] = c;
+    pRing->in = next;
+    return 1;
+}
+
+// takes a character from the ring buffer; must be called with interrupts disabled
+static inline uint8_t _uart_ringGet(struct UartRing *pRing, char *pC)
+{
+    if (pRing->out == pRing->in)
+        return 0; // empty
+    *pC = pRing->pData[pRing->out];
+    pRing->out = (pRing->out + 1 == pRing->size) ? 0 : pRing->out + 1;
+    return 1;
+}
+
+// computes the baud rate setting like UART_SETTING, but at runtime and without floating point
+static uint16_t _uart_setting(uint32_t baudrate)
+{
+    uint32_t clocks16 = 16 * baudrate;
+    uint32_t clocks8 = 8 * baudrate;
+    uint32_t ubrr16 = (F_CPU + clocks16 / 2) / clocks16 - 1;
+    uint32_t ubrr8 = (F_CPU + clocks8 / 2) / clocks8 - 1;
+    int32_t dev16 = F_CPU - clocks16 * (ubrr16 + 1);
+    int32_t dev8 = F_CPU - clocks8 * (ubrr8 + 1);
+
+    if (ubrr8 <= 4095 && (ubrr16 > 4095 || labs(dev8) < labs(dev16)))
+        return ubrr8 | UART_SETTING_U2X;
+    return ubrr16 > 4095 ? 4095 : ubrr16;
+}
+
+#if UART0_TX_BUFFER_SIZE > 254 || UART0_RX_BUFFER_SIZE > 254 || UART1_TX_BUFFER_SIZE > 254 || UART1_RX_BUFFER_SIZE > 254 || \
+    UART2_TX_BUFFER_SIZE > 254 || UART2_RX_BUFFER_SIZE > 254 || UART3_TX_BUFFER_SIZE > 254 || UART3_RX_BUFFER_SIZE > 254
+#error "the UART buffer sizes must not exceed 254"
+#endif
 
 // ----------------------------------------------------------------------------
 // generate code for UART0
 // ----------------------------------------------------------------------------
 #define uartx_init uart0_init
+#define uartx_initBaud uart0_initBaud
 #define uartx_putc uart0_putc
 #define uartx_puts uart0_puts
 #define uartx_getc uart0_getc
@@ -19,8 +75,26 @@
 #define UBRRx UBRR0
 #define UDRx UDR0
 #define uartx_initialized uart0_initialized
+#define uartx_write uart0_write
+#define uartx_getTxFree uart0_getTxFree
+#define uartx_puts_P uart0_puts_P
+#define uartx_msg_P uart0_msg_P
+#define uartx_read uart0_read
+#define uartx_getTxOverflows uart0_getTxOverflows
+#define uartx_isTxIdle uart0_isTxIdle
+#define uartx_txActive uart0_txActive
+#define uartx_getRxOverflows uart0_getRxOverflows
+#define uartx_tx uart0_tx
+#define uartx_txData uart0_txData
+#define uartx_rx uart0_rx
+#define uartx_rxData uart0_rxData
+#define UARTx_TX_SIZE UART0_TX_BUFFER_SIZE
+#define UARTx_RX_SIZE UART0_RX_BUFFER_SIZE
+#define UARTx_UDRE_vect USART0_UDRE_vect
+#define UARTx_RX_vect USART0_RX_vect
 #include "uart_src.h"
 #undef uartx_init
+#undef uartx_initBaud
 #undef uartx_putc
 #undef uartx_puts
 #undef uartx_getc
@@ -32,11 +106,29 @@
 #undef UBRRx
 #undef UDRx
 #undef uartx_initialized
+#undef uartx_write
+#undef uartx_getTxFree
+#undef uartx_puts_P
+#undef uartx_msg_P
+#undef uartx_read
+#undef uartx_getTxOverflows
+#undef uartx_isTxIdle
+#undef uartx_txActive
+#undef uartx_getRxOverflows
+#undef uartx_tx
+#undef uartx_txData
+#undef uartx_rx
+#undef uartx_rxData
+#undef UARTx_TX_SIZE
+#undef UARTx_RX_SIZE
+#undef UARTx_UDRE_vect
+#undef UARTx_RX_vect
 
 // ----------------------------------------------------------------------------
 // generate code for UART1
 // ----------------------------------------------------------------------------
 #define uartx_init uart1_init
+#define uartx_initBaud uart1_initBaud
 #define uartx_putc uart1_putc
 #define uartx_puts uart1_puts
 #define uartx_getc uart1_getc
@@ -48,8 +140,26 @@
 #define UBRRx UBRR1
 #define UDRx UDR1
 #define uartx_initialized uart1_initialized
+#define uartx_write uart1_write
+#define uartx_getTxFree uart1_getTxFree
+#define uartx_puts_P uart1_puts_P
+#define uartx_msg_P uart1_msg_P
+#define uartx_read uart1_read
+#define uartx_getTxOverflows uart1_getTxOverflows
+#define uartx_isTxIdle uart1_isTxIdle
+#define uartx_txActive uart1_txActive
+#define uartx_getRxOverflows uart1_getRxOverflows
+#define uartx_tx uart1_tx
+#define uartx_txData uart1_txData
+#define uartx_rx uart1_rx
+#define uartx_rxData uart1_rxData
+#define UARTx_TX_SIZE UART1_TX_BUFFER_SIZE
+#define UARTx_RX_SIZE UART1_RX_BUFFER_SIZE
+#define UARTx_UDRE_vect USART1_UDRE_vect
+#define UARTx_RX_vect USART1_RX_vect
 #include "uart_src.h"
 #undef uartx_init
+#undef uartx_initBaud
 #undef uartx_putc
 #undef uartx_puts
 #undef uartx_getc
@@ -61,11 +171,29 @@
 #undef UBRRx
 #undef UDRx
 #undef uartx_initialized
+#undef uartx_write
+#undef uartx_getTxFree
+#undef uartx_puts_P
+#undef uartx_msg_P
+#undef uartx_read
+#undef uartx_getTxOverflows
+#undef uartx_isTxIdle
+#undef uartx_txActive
+#undef uartx_getRxOverflows
+#undef uartx_tx
+#undef uartx_txData
+#undef uartx_rx
+#undef uartx_rxData
+#undef UARTx_TX_SIZE
+#undef UARTx_RX_SIZE
+#undef UARTx_UDRE_vect
+#undef UARTx_RX_vect
 
 // ----------------------------------------------------------------------------
 // generate code for UART2
 // ----------------------------------------------------------------------------
 #define uartx_init uart2_init
+#define uartx_initBaud uart2_initBaud
 #define uartx_putc uart2_putc
 #define uartx_puts uart2_puts
 #define uartx_getc uart2_getc
@@ -77,8 +205,26 @@
 #define UBRRx UBRR2
 #define UDRx UDR2
 #define uartx_initialized uart2_initialized
+#define uartx_write uart2_write
+#define uartx_getTxFree uart2_getTxFree
+#define uartx_puts_P uart2_puts_P
+#define uartx_msg_P uart2_msg_P
+#define uartx_read uart2_read
+#define uartx_getTxOverflows uart2_getTxOverflows
+#define uartx_isTxIdle uart2_isTxIdle
+#define uartx_txActive uart2_txActive
+#define uartx_getRxOverflows uart2_getRxOverflows
+#define uartx_tx uart2_tx
+#define uartx_txData uart2_txData
+#define uartx_rx uart2_rx
+#define uartx_rxData uart2_rxData
+#define UARTx_TX_SIZE UART2_TX_BUFFER_SIZE
+#define UARTx_RX_SIZE UART2_RX_BUFFER_SIZE
+#define UARTx_UDRE_vect USART2_UDRE_vect
+#define UARTx_RX_vect USART2_RX_vect
 #include "uart_src.h"
 #undef uartx_init
+#undef uartx_initBaud
 #undef uartx_putc
 #undef uartx_puts
 #undef uartx_getc
@@ -90,11 +236,29 @@
 #undef UBRRx
 #undef UDRx
 #undef uartx_initialized
+#undef uartx_write
+#undef uartx_getTxFree
+#undef uartx_puts_P
+#undef uartx_msg_P
+#undef uartx_read
+#undef uartx_getTxOverflows
+#undef uartx_isTxIdle
+#undef uartx_txActive
+#undef uartx_getRxOverflows
+#undef uartx_tx
+#undef uartx_txData
+#undef uartx_rx
+#undef uartx_rxData
+#undef UARTx_TX_SIZE
+#undef UARTx_RX_SIZE
+#undef UARTx_UDRE_vect
+#undef UARTx_RX_vect
 
 // ----------------------------------------------------------------------------
 // generate code for UART3
 // ----------------------------------------------------------------------------
 #define uartx_init uart3_init
+#define uartx_initBaud uart3_initBaud
 #define uartx_putc uart3_putc
 #define uartx_puts uart3_puts
 #define uartx_getc uart3_getc
@@ -106,8 +270,26 @@
 #define UBRRx UBRR3
 #define UDRx UDR3
 #define uartx_initialized uart3_initialized
+#define uartx_write uart3_write
+#define uartx_getTxFree uart3_getTxFree
+#define uartx_puts_P uart3_puts_P
+#define uartx_msg_P uart3_msg_P
+#define uartx_read uart3_read
+#define uartx_getTxOverflows uart3_getTxOverflows
+#define uartx_isTxIdle uart3_isTxIdle
+#define uartx_txActive uart3_txActive
+#define uartx_getRxOverflows uart3_getRxOverflows
+#define uartx_tx uart3_tx
+#define uartx_txData uart3_txData
+#define uartx_rx uart3_rx
+#define uartx_rxData uart3_rxData
+#define UARTx_TX_SIZE UART3_TX_BUFFER_SIZE
+#define UARTx_RX_SIZE UART3_RX_BUFFER_SIZE
+#define UARTx_UDRE_vect USART3_UDRE_vect
+#define UARTx_RX_vect USART3_RX_vect
 #include "uart_src.h"
 #undef uartx_init
+#undef uartx_initBaud
 #undef uartx_putc
 #undef uartx_puts
 #undef uartx_getc
@@ -119,3 +301,20 @@
 #undef UBRRx
 #undef UDRx
 #undef uartx_initialized
+#undef uartx_write
+#undef uartx_getTxFree
+#undef uartx_puts_P
+#undef uartx_msg_P
+#undef uartx_read
+#undef uartx_getTxOverflows
+#undef uartx_isTxIdle
+#undef uartx_txActive
+#undef uartx_getRxOverflows
+#undef uartx_tx
+#undef uartx_txData
+#undef uartx_rx
+#undef uartx_rxData
+#undef UARTx_TX_SIZE
+#undef UARTx_RX_SIZE
+#undef UARTx_UDRE_vect
+#undef UARTx_RX_vect
@@ -0,0 +1,245 @@
+#!/usr/bin/env python3
+"""Measures and calibrates variables on the robot with the DAQ library (see include/daq.h).
+
+Usage:
+    daq.py --port /dev/ttyACM0 --elf firmware.elf measure VAR... [--period MS | --event dbmc [--every N]]
+    daq.py --port /dev/ttyACM0 --elf firmware.elf read VAR...
+    daq.py --port /dev/ttyACM0 --elf firmware.elf write VAR=VALUE...
+
+A variable is given as NAME[:TYPE][[COUNT]], e.g. _dbMc_ticksLeft:i16, OCR5A or
+_dbCs_values:u8[12]. NAME is a symbol of the ELF file (static variables included),
+one of the I/O registers below or an address like 0x128. Without a type, the size
+of the symbol decides (u8, u16, u32 or an u8 array). measure writes CSV to stdout
+until it is interrupted.
+
+The commands are sent as frames of the MUX library on --channel (MUX_CH_CMD by
+default); the responses and samples are TLM records, which are expected either
+on the telemetry channel of the MUX library (TLM_MUX) or directly on UART0.
+"""
+
+import argparse
+import csv
+import os
+import re
+import select
+import struct
+import subprocess
+import sys
+import termios
+import time
+
+from tlm_decode import HEADER, cobs_decode, crc16
+from mux_demux import CRC_INIT, encode
+
+TLM_T_DAQ, TLM_T_DAQ_RESPONSE = 9, 10
+MUX_CH_TLM = 2
+CONNECT, CLEAR, ADD, START, STOP, READ, WRITE, STOP_ALL = range(1, 9)
+EVENTS = {"timer": 0, "dbmc": 1}
+STATUS = ["ok", "unknown command", "invalid parameter", "list full", "list running", "timebase"]
+TYPES = {"u8": "B", "i8": "b", "u16": "H", "i16": "h", "u32": "I", "i32": "i"}
+SIZE_TYPES = {1: "u8", 2: "u16", 4: "u32"}
+IO_REGISTERS = {  # ATmega2560 data addresses of the registers used by the libraries
+    "ADC": (0x78, 2), "TCNT4": (0xA4, 2), "OCR4A": (0xA8, 2),
+    "TCNT5": (0x124, 2), "ICR5": (0x126, 2), "OCR5A": (0x128, 2), "OCR5B": (0x12A, 2), "OCR5C": (0x12C, 2),
+}
+SPEC = re.compile(r"^(\w+)(?::(\w+))?(?:\[(\d+)\])?$")
+
+
+class Variable:
+    def __init__(self, spec, symbols):
+        match = SPEC.match(spec)
+        if not match:
+            raise SystemExit(f"invalid variable: {spec}")
+        self.name, type_, count = match.group(1), match.group(2), match.group(3)
+        if self.name in symbols:
+            self.address, size = symbols[self.name]
+        elif self.name in IO_REGISTERS:
+            self.address, size = IO_REGISTERS[self.name]
+        elif re.match(r"^(0x[0-9a-fA-F]+|\d+)$", self.name):
+            self.address, size = int(self.name, 0), 1
+        else:
+            raise SystemExit(f"unknown variable: {self.name}")
+        if type_ is None:
+            type_ = SIZE_TYPES.get(size, "u8")
+            if count is None and size not in SIZE_TYPES:
+                count = str(size)
+        if type_ not in TYPES:
+            raise SystemExit(f"unknown type: {type_}")
+        self.count = int(count or 1)
+        self.format = "<" + TYPES[type_] * self.count
+        self.size = struct.calcsize(self.format)
+
+    def columns(self):
+        return [self.name] if self.count == 1 else [f"{self.name}[{i}]" for i in range(self.count)]
+
+
+def load_symbols(elf, nm):
+    """Returns name -> (data address, size) of the variables in the SRAM."""
+    symbols = {}
+    if not elf:
+        return symbols
+    output = subprocess.run([nm, "-S", elf], capture_output=True, text=True, check=True).stdout
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in "bBdD":
+            address = int(parts[0], 16)
+            if address >= 0x800000:
+                symbols[parts[3]] = (address - 0x800000, int(parts[1], 16))
+    return symbols
+
+
+class Link:
+    """Sends DAQ commands and receives the TLM records."""
+
+    def __init__(self, port, baudrate, channel):
+        self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            attrs = termios.tcgetattr(self.fd)
+            attrs[0] = attrs[1] = attrs[3] = 0                 # raw input, output and local modes
+            attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+            speed = getattr(termios, f"B{baudrate}", None)
+            if speed is not None:
+                attrs[4] = attrs[5] = speed
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.channel = channel
+        self.buffer = bytearray()
+        self.tlm_buffer = bytearray()  # the telemetry channel's stream, when multiplexed
+
+    def send(self, *data):
+        os.write(self.fd, encode(self.channel, bytes(data)))
+
+    def _tlm(self, raw):
+        try:
+            frame = cobs_decode(raw)
+        except ValueError:
+            return None
+        if len(frame) < HEADER.size + 2 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+            return None
+        rtype, _, time_us = HEADER.unpack_from(frame)
+        return rtype, time_us, frame[HEADER.size:-2]
+
+    def records(self, timeout=None):
+        """Yields (type, time_us, payload) of the received TLM records."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            wait = None if deadline is None else max(0, deadline - time.monotonic())
+            if not select.select([self.fd], [], [], wait)[0]:
+                return
+            self.buffer += os.read(self.fd, 4096)
+            while 0 in self.buffer:
+                end = self.buffer.index(0)
+                raw = bytes(self.buffer[:end])
+                del self.buffer[:end + 1]
+                if not raw:
+                    continue
+                mux = self._mux(raw)
+                if mux is None:
+                    record = self._tlm(raw)  # not multiplexed
+                    if record:
+                        yield record
+                elif mux[0] == MUX_CH_TLM:
+                    self.tlm_buffer += mux[1]
+                    while 0 in self.tlm_buffer:
+                        end = self.tlm_buffer.index(0)
+                        record = self._tlm(bytes(self.tlm_buffer[:end])) if end else None
+                        del self.tlm_buffer[:end + 1]
+                        if record:
+                            yield record
+
+    @staticmethod
+    def _mux(raw):
+        try:
+            frame = cobs_decode(raw)
+        except ValueError:
+            return None
+        if len(frame) < 3 or crc16(frame[:-2], CRC_INIT) != struct.unpack("<H", frame[-2:])[0]:
+            return None
+        return frame[0], frame[1:-2]
+
+    def command(self, *data):
+        """Sends a command and returns the data of its response."""
+        self.send(*data)
+        for rtype, _, payload in self.records(timeout=1.0):
+            if rtype == TLM_T_DAQ_RESPONSE and payload[0] == data[0]:
+                if payload[1]:
+                    status = STATUS[payload[1]] if payload[1] < len(STATUS) else payload[1]
+                    raise SystemExit(f"command {data[0]} failed: {status}")
+                return payload[2:]
+        raise SystemExit("no response; is daq_init called and the channel right?")
+
+
+def measure(link, variables, args):
+    link.command(STOP_ALL)
+    link.command(CLEAR, 0)
+    for var in variables:
+        link.command(ADD, 0, *struct.pack("<HB", var.address, var.size))
+    event = EVENTS.get(args.event, None)
+    if event is None:
+        event = int(args.event, 0)
+    period = args.period if event == 0 else args.every
+    link.command(START, 0, event, *struct.pack("<H", period))
+
+    writer = csv.writer(sys.stdout)
+    writer.writerow(["time_us", "counter"] + [c for var in variables for c in var.columns()])
+    lost, last = 0, None
+    try:
+        for rtype, time_us, payload in link.records():
+            if rtype != TLM_T_DAQ or payload[0] != 0:
+                continue
+            if last is not None and payload[1] != (last + 1) & 0xFF:
+                lost += (payload[1] - last - 1) & 0xFF
+            last = payload[1]
+            row, offset = [time_us, payload[1]], 2
+            for var in variables:
+                row += struct.unpack_from(var.format, payload, offset)
+                offset += var.size
+            writer.writerow(row)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        link.command(STOP, 0)
+        print(f"{lost} samples lost", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measures and calibrates variables with the DAQ library.")
+    parser.add_argument("--port", required=True, help="the serial device")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--elf", help="the firmware, to look up the variables")
+    parser.add_argument("--nm", default="avr-nm", help="the nm of the AVR toolchain")
+    parser.add_argument("--channel", type=int, default=1, help="the MUX channel passed to daq_init")
+    sub = parser.add_subparsers(dest="action", required=True)
+    p = sub.add_parser("measure")
+    p.add_argument("variables", nargs="+")
+    p.add_argument("--period", type=int, default=50, help="the sampling period in ms (event timer)")
+    p.add_argument("--event", default="timer", help="timer, dbmc or a number")
+    p.add_argument("--every", type=int, default=1, help="sample every N-th event")
+    p = sub.add_parser("read")
+    p.add_argument("variables", nargs="+")
+    p = sub.add_parser("write")
+    p.add_argument("assignments", nargs="+", help="VAR=VALUE")
+    args = parser.parse_args()
+
+    symbols = load_symbols(args.elf, args.nm)
+    link = Link(args.port, args.baud, args.channel)
+    version, lists, entries, size = link.command(CONNECT)[:4]
+    print(f"DAQ version {version}: {lists} lists, {entries} entries, {size} bytes", file=sys.stderr)
+
+    if args.action == "measure":
+        measure(link, [Variable(spec, symbols) for spec in args.variables], args)
+    elif args.action == "read":
+        for spec in args.variables:
+            var = Variable(spec, symbols)
+            values = struct.unpack(var.format, link.command(READ, *struct.pack("<HB", var.address, var.size)))
+            print(var.name, *values)
+    else:
+        for assignment in args.assignments:
+            spec, _, value = assignment.partition("=")
+            var = Variable(spec, symbols)
+            values = [int(v, 0) for v in value.split(",")]
+            link.command(WRITE, *struct.pack("<H", var.address), *struct.pack(var.format, *values))
+
+
+if __name__ == "__main__":
+    main()
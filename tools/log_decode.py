@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Formats the log records of the LOG library (see include/log.h) on the host.
+
+Usage:
+    log_decode.py [capture.bin] [-m include/logmsg.h] [-m appmsg.h] [--level LEVEL]
+
+The captured byte stream of UART0 is split into TLM frames by tlm_decode.py; the
+TLM_T_LOG records are formatted with the message table, one line per message
+(time in seconds, level, text). The tables are read in the order given, like
+logmsg.h includes the application's messages (LOG_USER_MESSAGES) at its end.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+from tlm_decode import records
+
+TLM_T_LOG = 8
+LEVELS = {"LOG_DEBUG": 0, "LOG_INFO": 1, "LOG_WARN": 2, "LOG_ERROR": 3}
+LEVEL_NAMES = ["DEBUG", "INFO", "WARN", "ERROR"]
+
+MESSAGE = re.compile(r'^\s*LOG_MSG\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', re.M)
+CONVERSION = re.compile(r"%(-?\d*)(l?)([duxXc%])")
+
+DEFAULT_TABLE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "include", "logmsg.h")
+
+
+def load_messages(paths):
+    """Returns the list of (name, level, format); the index is the message ID."""
+    messages = []
+    for path in paths:
+        with open(path) as f:
+            for name, level, fmt in MESSAGE.findall(f.read()):
+                messages.append((name, LEVELS.get(level, 0), bytes(fmt, "ascii").decode("unicode_escape")))
+    return messages
+
+
+def format_message(fmt, args):
+    """Formats the 16 bit arguments like the AVR's printf would."""
+    args = list(args)
+
+    def convert(match):
+        width, long_, kind = match.groups()
+        if kind == "%":
+            return "%"
+        if not args:
+            return "?"
+        value = args.pop(0)
+        if long_:
+            value |= (args.pop(0) if args else 0) << 16
+        bits = 32 if long_ else 16
+        if kind == "d" and value & (1 << (bits - 1)):
+            value -= 1 << bits
+        if kind == "c":
+            return chr(value & 0xFF)
+        return ("%" + width + ("d" if kind == "u" else kind)) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def log_records(payload):
+    """Yields (message ID, arguments) of a TLM_T_LOG payload."""
+    i = 0
+    while i + 2 <= len(payload):
+        msg_id, count = payload[i], payload[i + 1]
+        end = i + 2 + 2 * count
+        if end > len(payload):
+            break
+        yield msg_id, struct.unpack_from(f"<{count}H", payload, i + 2)
+        i = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Formats captured LOG records.")
+    parser.add_argument("input", nargs="?", help="the captured byte stream; stdin if omitted")
+    parser.add_argument("-m", "--messages", action="append",
+                        help="a message table; include/logmsg.h if omitted")
+    parser.add_argument("--level", choices=LEVEL_NAMES, default="DEBUG", help="the lowest level to show")
+    args = parser.parse_args()
+
+    messages = load_messages(args.messages or [DEFAULT_TABLE])
+    min_level = LEVEL_NAMES.index(args.level)
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    stats = {"seq": None, "records": 0, "lost": 0, "corrupted": 0}
+
+    for rtype, _, time_us, payload in records(stream, stats):
+        if rtype != TLM_T_LOG:
+            continue
+        for msg_id, values in log_records(payload):
+            if msg_id < len(messages):
+                _, level, fmt = messages[msg_id]
+                text = format_message(fmt, values)
+            else:
+                level, text = 0, f"unknown message {msg_id}: " + " ".join(f"{v:04x}" for v in values)
+            if level >= min_level:
+                print(f"{time_us / 1e6:12.6f} {LEVEL_NAMES[level]:5} {text}")
+
+    print(f"{stats['records']} records, {stats['lost']} lost, {stats['corrupted']} corrupted frames",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Splits the virtual channels of the MUX library (see include/mux.h) into separate streams.
+
+Usage:
+    mux_demux.py [capture.bin|/dev/ttyACM0] --channel N        # channel N to stdout
+    mux_demux.py [capture.bin|/dev/ttyACM0] --split PREFIX     # PREFIX.chN per channel, PREFIX.raw
+    mux_demux.py --encode N < data > /dev/ttyACM0              # sends data on channel N
+
+Bytes between the frames (e.g. text sent by uart0_msg) form the raw stream, which
+--channel raw selects. The telemetry channel can be piped into tlm_decode.py or
+log_decode.py, e.g.: mux_demux.py capture.bin --channel 2 | tlm_decode.py
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from tlm_decode import cobs_decode, crc16
+
+CHUNK_SIZE = 32  # MUX_CHUNK_SIZE
+CRC_INIT = 0x1D0F  # MUX_CRC_INIT
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_index, code = 0, 1
+    for byte in data:
+        if byte:
+            out.append(byte)
+            code += 1
+        if not byte or code == 0xFF:
+            out[code_index] = code
+            code_index, code = len(out), 1
+            out.append(0)
+    out[code_index] = code
+    return bytes(out)
+
+
+def encode(channel, data):
+    """Returns the frames, which send data on the channel."""
+    frames = bytearray()
+    for i in range(0, len(data), CHUNK_SIZE):
+        frame = bytes([channel]) + data[i:i + CHUNK_SIZE]
+        frames += b"\0" + cobs_encode(frame + struct.pack("<H", crc16(frame, CRC_INIT))) + b"\0"
+    return bytes(frames)
+
+
+def demux(fd, stats):
+    """Yields (channel, data); channel is None for bytes between the frames."""
+    buffer = bytearray()
+    while True:
+        chunk = os.read(fd, 4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            end = buffer.find(0)
+            if end < 0:
+                break
+            raw = bytes(buffer[:end])
+            del buffer[:end + 1]
+            if not raw:
+                continue
+            try:
+                frame = cobs_decode(raw)
+            except ValueError:
+                frame = b""
+            if len(frame) >= 3 and crc16(frame[:-2], CRC_INIT) == struct.unpack("<H", frame[-2:])[0]:
+                stats["frames"] += 1
+                yield frame[0], frame[1:-2]
+            else:
+                yield None, raw  # text between the frames or a corrupted frame
+    if buffer:
+        yield None, bytes(buffer)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Splits the virtual channels of the MUX library.")
+    parser.add_argument("input", nargs="?", help="the byte stream or serial device; stdin if omitted")
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument("--channel", help="write this channel (a number or 'raw') to stdout")
+    group.add_argument("--split", metavar="PREFIX", help="write every channel to PREFIX.chN and PREFIX.raw")
+    group.add_argument("--encode", type=int, metavar="N", help="encode stdin as frames of channel N")
+    args = parser.parse_args()
+
+    if args.encode is not None:
+        sys.stdout.buffer.write(encode(args.encode, sys.stdin.buffer.read()))
+        return
+
+    fd = os.open(args.input, os.O_RDONLY) if args.input else sys.stdin.fileno()
+    stats = {"frames": 0}
+    outputs = {}
+    wanted = None if args.split else (None if args.channel == "raw" else int(args.channel))
+
+    for channel, data in demux(fd, stats):
+        if args.split:
+            if channel not in outputs:
+                suffix = "raw" if channel is None else f"ch{channel}"
+                outputs[channel] = open(f"{args.split}.{suffix}", "wb")
+            out = outputs[channel]
+        elif channel == wanted:
+            out = sys.stdout.buffer
+        else:
+            continue
+        out.write(data)
+        out.flush()
+
+    print(f"{stats['frames']} frames", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
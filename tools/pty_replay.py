@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Replays recorded robot streams on pseudo-terminals, to test the host tools without robots.
+
+Usage:
+    pty_replay.py capture.bin... [--copies N] [--baud 1000000] [--loop] [--link DIR]
+
+Every capture is replayed on N pseudo-terminals at the speed of the given baud rate
+(10 bits per byte). The paths of the terminals are printed one per line (and linked
+as DIR/robotN, if --link is given), e.g.:
+    pty_replay.py capture.bin --copies 24 --link /tmp/bots &
+    tlm_aggregate.py /tmp/bots/robot*
+"""
+
+import argparse
+import os
+import pty
+import sys
+import threading
+import time
+import tty
+
+CHUNK_TIME = 0.005  # the data of 5 ms are written at once
+
+
+def replay(fd, data, baudrate, loop, start):
+    chunk = max(1, int(baudrate / 10 * CHUNK_TIME))
+    bytes_per_s = baudrate / 10
+    sent = 0
+    while True:
+        for offset in range(0, len(data), chunk):
+            os.write(fd, data[offset:offset + chunk])
+            sent += min(chunk, len(data) - offset)
+            delay = start + sent / bytes_per_s - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        if not loop:
+            break
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replays recorded streams on pseudo-terminals.")
+    parser.add_argument("captures", nargs="+")
+    parser.add_argument("--copies", type=int, default=1, help="the number of terminals per capture")
+    parser.add_argument("--baud", type=int, default=1000000)
+    parser.add_argument("--loop", action="store_true", help="repeat the captures until interrupted")
+    parser.add_argument("--link", metavar="DIR", help="create the symbolic links DIR/robotN")
+    parser.add_argument("--delay", type=float, default=1.0, help="the time in s to wait before replaying")
+    args = parser.parse_args()
+
+    terminals = []
+    for capture in args.captures:
+        with open(capture, "rb") as f:
+            data = f.read()
+        for _ in range(args.copies):
+            master, slave = pty.openpty()
+            tty.setraw(slave)
+            terminals.append((master, slave, os.ttyname(slave), data))
+
+    if args.link:
+        os.makedirs(args.link, exist_ok=True)
+    for i, (_, _, path, _) in enumerate(terminals):
+        if args.link:
+            link = os.path.join(args.link, f"robot{i}")
+            if os.path.lexists(link):
+                os.remove(link)
+            os.symlink(path, link)
+        print(path, flush=True)
+
+    time.sleep(args.delay)  # give the reader time to open the terminals
+    start = time.monotonic()
+    threads = [threading.Thread(target=replay, args=(master, data, args.baud, args.loop, start), daemon=True)
+               for master, _, _, data in terminals]
+    for thread in threads:
+        thread.start()
+    try:
+        for thread in threads:
+            thread.join()
+        time.sleep(0.5)  # let the reader drain the terminals before they are closed
+    except KeyboardInterrupt:
+        pass
+    print(f"replayed {len(terminals)} streams", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
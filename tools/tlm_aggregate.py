@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+"""Collects the output of many robots at once (text, TLM and MUX frames, see include/tlm.h).
+
+Usage:
+    tlm_aggregate.py DEVICE... [--baud 1000000] [-o DIR] [--stats 1.0]
+
+A device is given as PATH or NAME=PATH (e.g. bot3=/dev/ttyUSB3). Every device is read by
+its own thread of a thread pool, which only timestamps the received chunks; a single
+decoder thread splits them into text lines and records. It writes
+    DIR/NAME/<type>.csv   one file per record type with a column per field,
+    DIR/NAME/lines.csv    the text lines written between the frames and
+    DIR/merged.csv        all records (field=value ...) and lines of all robots in the order
+                          of reception,
+and prints the rates and errors of every robot every --stats seconds. The records are
+timestamped by the host (seconds since the start) and carry the robot's time_us.
+Recorded streams can be replayed to pseudo-terminals with pty_replay.py.
+"""
+
+import argparse
+import csv
+import os
+import queue
+import select
+import struct
+import sys
+import termios
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from tlm_decode import HEADER, cobs_decode, crc16, fields
+from mux_demux import CRC_INIT
+
+MUX_CH_TLM = 2
+MAX_FRAME = 300     # longer segments can only be text
+READ_SIZE = 65536
+
+
+def open_device(path, baudrate):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY | os.O_NONBLOCK)
+    if os.isatty(fd):
+        attrs = termios.tcgetattr(fd)
+        attrs[0] = attrs[1] = attrs[3] = 0                  # raw input, output and local modes
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        speed = getattr(termios, f"B{baudrate}", None)
+        if speed is not None:
+            attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def check_frame(raw, header_size, crc=0xFFFF):
+    """Returns the COBS decoded frame without the CRC, or None if it is not valid."""
+    try:
+        frame = cobs_decode(raw)
+    except ValueError:
+        return None
+    if len(frame) < header_size + 2 or crc16(frame[:-2], crc) != struct.unpack("<H", frame[-2:])[0]:
+        return None
+    return frame[:-2]
+
+
+class Robot:
+    """The decoding state and the statistics of one robot."""
+
+    def __init__(self, name):
+        self.name = name
+        self.buffer = bytearray()
+        self.tlm_buffer = bytearray()  # the stream of the MUX telemetry channel
+        self.seq = None
+        self.bytes = self.records = self.lines = self.lost = self.corrupted = 0
+        self.last = (0, 0, 0)          # bytes, records and lines at the last statistics
+
+    def feed(self, data):
+        """Yields ('text', line) and ('record', (type, seq, time_us, payload))."""
+        self.bytes += len(data)
+        self.buffer += data
+        while True:
+            end = self.buffer.find(0)
+            if end < 0:
+                break
+            segment = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if segment:
+                yield from self._segment(segment)
+        if len(self.buffer) > MAX_FRAME:  # a plain text stream
+            end = self.buffer.rfind(b"\n") + 1
+            if end:
+                yield from self._text(bytes(self.buffer[:end]))
+                del self.buffer[:end]
+
+    def _segment(self, segment):
+        frame = check_frame(segment, HEADER.size)
+        if frame is not None:
+            yield from self._record(frame)
+            return
+        mux = check_frame(segment, 1, CRC_INIT)
+        if mux is not None and mux[0] == MUX_CH_TLM:
+            self.tlm_buffer += mux[1:]
+            while 0 in self.tlm_buffer:
+                end = self.tlm_buffer.index(0)
+                frame = check_frame(bytes(self.tlm_buffer[:end]), HEADER.size) if end else None
+                del self.tlm_buffer[:end + 1]
+                if frame is not None:
+                    yield from self._record(frame)
+            return
+        if mux is not None:
+            yield from self._text(mux[1:])  # other channels carry text
+            return
+        if any(b < 0x09 or 0x0D < b < 0x20 and b != 0x1B for b in segment):
+            self.corrupted += 1
+        else:
+            yield from self._text(segment)
+
+    def _record(self, frame):
+        rtype, seq, time_us = HEADER.unpack_from(frame)
+        if self.seq is not None and (seq - self.seq) & 0xFF >= 0x80:
+            self.lost = max(self.lost - 1, 0)  # overtaken by a record sent by an interrupt
+        else:
+            if self.seq is not None:
+                self.lost += (seq - self.seq - 1) & 0xFF
+            self.seq = seq
+        self.records += 1
+        yield "record", (rtype, seq, time_us, frame[HEADER.size:])
+
+    def _text(self, data):
+        for line in data.decode("ascii", "replace").splitlines():
+            if line:
+                self.lines += 1
+                yield "text", line
+
+
+class Writer:
+    """Writes the per-robot CSV files and the merged file."""
+
+    def __init__(self, directory):
+        self.directory = directory
+        self.files = []
+        self.writers = {}
+        self.merged = self._writer(None, "merged", ["host_time", "robot", "time_us", "seq", "type", "values"])
+
+    def _writer(self, robot, name, header):
+        key = (robot, name)
+        if key not in self.writers:
+            path = os.path.join(self.directory, robot or "", name + ".csv")
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            handle = open(path, "w", newline="")
+            self.files.append(handle)
+            self.writers[key] = csv.writer(handle)
+            self.writers[key].writerow(header)
+        return self.writers[key]
+
+    def text(self, host_time, robot, line):
+        host_time = f"{host_time:.6f}"
+        self._writer(robot, "lines", ["host_time", "line"]).writerow([host_time, line])
+        self.merged.writerow([host_time, robot, "", "", "line", line])
+
+    def record(self, host_time, robot, record):
+        rtype, seq, time_us, payload = record
+        name, values = fields(rtype, payload)
+        host_time = f"{host_time:.6f}"
+        header = ["host_time", "time_us", "seq"] + [field for field, _ in values]
+        self._writer(robot, name, header).writerow([host_time, time_us, seq] + [value for _, value in values])
+        self.merged.writerow([host_time, robot, time_us, seq, name,
+                              " ".join(f"{field}={value}" for field, value in values)])
+
+    def flush(self):
+        for handle in self.files:
+            handle.flush()
+
+    def close(self):
+        for handle in self.files:
+            handle.close()
+
+
+def read_device(name, path, baudrate, chunks, stop):
+    """Runs in the thread pool; passes (name, host time, data) to the decoder."""
+    try:
+        fd = open_device(path, baudrate)
+    except OSError as error:
+        print(f"{name}: {error}", file=sys.stderr)
+        chunks.put((name, time.monotonic(), None))
+        return
+    try:
+        while not stop.is_set():
+            if select.select([fd], [], [], 0.2)[0]:
+                try:
+                    data = os.read(fd, READ_SIZE)
+                except BlockingIOError:
+                    continue
+                except OSError:  # e.g. the other side of a pty has been closed
+                    break
+                if not data:
+                    break
+                chunks.put((name, time.monotonic(), data))
+    finally:
+        os.close(fd)
+        chunks.put((name, time.monotonic(), None))
+
+
+def print_stats(robots, elapsed):
+    lines = [f"{'robot':12} {'kB/s':>8} {'rec/s':>8} {'lines/s':>8} {'lost':>6} {'bad':>6}"]
+    totals = [0, 0, 0]
+    for robot in robots.values():
+        rates = [(now - before) / elapsed for now, before in
+                 zip((robot.bytes, robot.records, robot.lines), robot.last)]
+        robot.last = (robot.bytes, robot.records, robot.lines)
+        totals = [t + r for t, r in zip(totals, rates)]
+        lines.append(f"{robot.name:12} {rates[0] / 1000:8.1f} {rates[1]:8.0f} {rates[2]:8.0f} "
+                     f"{robot.lost:6} {robot.corrupted:6}")
+    lines.append(f"{'total':12} {totals[0] / 1000:8.1f} {totals[1]:8.0f} {totals[2]:8.0f}")
+    print("\n".join(lines) + "\n", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Collects the output of many robots at once.")
+    parser.add_argument("devices", nargs="+", help="PATH or NAME=PATH")
+    parser.add_argument("--baud", type=int, default=1000000)
+    parser.add_argument("-o", "--output", default="robots", help="the directory of the CSV files")
+    parser.add_argument("--stats", type=float, default=1.0, help="the interval of the statistics in s; 0 for none")
+    args = parser.parse_args()
+
+    devices = {}
+    for i, device in enumerate(args.devices):
+        name, _, path = device.rpartition("=")
+        devices[name or f"robot{i}"] = path
+    robots = {name: Robot(name) for name in devices}
+    writer = Writer(args.output)
+    chunks = queue.Queue()
+    stop = threading.Event()
+    start = time.monotonic()
+    last_stats = start
+    open_devices = len(devices)
+
+    with ThreadPoolExecutor(max_workers=len(devices)) as pool:
+        for name, path in devices.items():
+            pool.submit(read_device, name, path, args.baud, chunks, stop)
+        try:
+            while open_devices:
+                try:
+                    name, host_time, data = chunks.get(timeout=0.2)
+                except queue.Empty:
+                    data = b""
+                    name = None
+                if name is not None and data is None:
+                    open_devices -= 1
+                elif data:
+                    for kind, item in robots[name].feed(data):
+                        if kind == "text":
+                            writer.text(host_time - start, name, item)
+                        else:
+                            writer.record(host_time - start, name, item)
+                now = time.monotonic()
+                if args.stats and now - last_stats >= args.stats:
+                    writer.flush()
+                    print_stats(robots, now - last_stats)
+                    last_stats = now
+        except KeyboardInterrupt:
+            pass
+        finally:
+            stop.set()
+    writer.close()
+    for robot in robots.values():
+        print(f"{robot.name}: {robot.bytes} bytes, {robot.records} records, {robot.lines} lines, "
+              f"{robot.lost} lost, {robot.corrupted} corrupted", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
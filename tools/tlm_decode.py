@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Decodes the binary telemetry of the TLM library (see include/tlm.h) into CSV.
+
+Usage:
+    tlm_decode.py [capture.bin] [--type NAME] [-o out.csv]
+
+Without --type, every record is written as one row per value
+(time_us,seq,type,field,value). With --type, only the records of that type are
+written, one row per record with a column per field. Lost records (gaps in the
+sequence numbers) and corrupted frames are reported on stderr.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+# type -> (name, struct format of the payload, field names); keep in sync with enum TlmType
+RECORD_TYPES = {
+    1: ("text", None, ["text"]),
+    2: ("uss", "<4B", ["front_cm", "back_cm", "left_cm", "right_cm"]),
+    3: ("irs", "<4B", ["front_cm", "back_cm", "left_cm", "right_cm"]),
+    4: ("colors", "<12B", [f"{side}_{c}" for side in ("left", "middle", "right") for c in "rbcg"]),
+    5: ("cs_calib", "<12H", [f"ocr{i}" for i in range(12)]),
+    6: ("mc", "<HHhhHH", ["target_left", "target_right", "ticks_left", "ticks_right", "ocr_left", "ocr_right"]),
+    7: ("cs_color_ref", "<13B", ["index"] + [f"ref{i}" for i in range(12)]),
+    8: ("log", None, None),  # formatted by tools/log_decode.py
+    9: ("daq", None, None),  # decoded by tools/daq.py
+    10: ("daq_response", None, None),
+}
+
+HEADER = struct.Struct("<BBI")  # type, sequence number, timestamp
+
+
+def _crc16_table():
+    table = []
+    for byte in range(256):
+        crc = byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+
+CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE (polynomial 0x1021, start value 0xFFFF) like _crc_xmodem_update."""
+    for byte in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC16_TABLE[(crc >> 8) ^ byte]
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("invalid COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(stream):
+    """Yields the raw frames of the byte stream, split at the 0 delimiters."""
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            end = buffer.find(0)
+            if end < 0:
+                break
+            yield bytes(buffer[:end])
+            del buffer[:end + 1]
+
+
+def records(stream, stats):
+    """Yields (type, seq, time_us, payload) of the valid frames."""
+    for raw in frames(stream):
+        if not raw:
+            continue
+        try:
+            frame = cobs_decode(raw)
+        except ValueError:
+            stats["corrupted"] += 1
+            continue
+        if len(frame) < HEADER.size + 2 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+            stats["corrupted"] += 1  # also text written between the frames ends up here
+            continue
+        rtype, seq, time_us = HEADER.unpack_from(frame)
+        if stats["seq"] is not None and (seq - stats["seq"]) & 0xFF >= 0x80:
+            stats["lost"] = max(stats["lost"] - 1, 0)  # overtaken by a record sent by an interrupt
+        else:
+            if stats["seq"] is not None:
+                stats["lost"] += (seq - stats["seq"] - 1) & 0xFF
+            stats["seq"] = seq
+        stats["records"] += 1
+        yield rtype, seq, time_us, frame[HEADER.size:-2]
+
+
+def fields(rtype, payload):
+    """Returns the record's name and its (field, value) pairs."""
+    name, fmt, names = RECORD_TYPES.get(rtype, (f"user{rtype:02x}", None, None))
+    if rtype == 1:
+        return name, [("text", payload.decode("ascii", "replace"))]
+    if fmt is None or struct.calcsize(fmt) != len(payload):
+        return name, [(f"b{i}", b) for i, b in enumerate(payload)]
+    return name, list(zip(names, struct.unpack(fmt, payload)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Converts captured TLM telemetry into CSV.")
+    parser.add_argument("input", nargs="?", help="the captured byte stream; stdin if omitted")
+    parser.add_argument("--type", help="only write the records of this type, one column per field")
+    parser.add_argument("-o", "--output", help="the CSV file; stdout if omitted")
+    args = parser.parse_args()
+
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    stats = {"seq": None, "records": 0, "lost": 0, "corrupted": 0}
+    header_written = False
+
+    if not args.type:
+        writer.writerow(["time_us", "seq", "type", "field", "value"])
+    for rtype, seq, time_us, payload in records(stream, stats):
+        name, values = fields(rtype, payload)
+        if args.type:
+            if name != args.type:
+                continue
+            if not header_written:
+                writer.writerow(["time_us", "seq"] + [field for field, _ in values])
+                header_written = True
+            writer.writerow([time_us, seq] + [value for _, value in values])
+        else:
+            for field, value in values:
+                writer.writerow([time_us, seq, name, field, value])
+
+    print(f"{stats['records']} records, {stats['lost']} lost, {stats['corrupted']} corrupted frames",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()